@@ -0,0 +1,332 @@
+#ifndef CONCURRENT_POLYVECTOR_H
+#define CONCURRENT_POLYVECTOR_H
+
+#include <atomic>
+#include <bit>
+#include "polyvector.h"
+
+// Multi-producer PolyVector. Appends claim a slot with a fetch_add and construct
+// in place. Storage is a table of segments that double in size, so growth never
+// relocates an element and references stay valid for the container's lifetime.
+// Readers only see the published prefix: slots that are fully constructed.
+// A slot whose constructor threw is published as abandoned, so later slots
+// still become visible; iteration and the destructor skip it, and indexing
+// code checks abandoned().
+template<typename Base, typename Allocator = std::allocator<Base>>
+class ConcurrentPolyVector {
+public:
+    // Member types
+    using value_type = Base;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+    using reference = Base&;
+    using pointer = Base*;
+    class iterator {
+        public:
+            // Member types
+            using difference_type = std::ptrdiff_t;
+            using value_type = Base;
+            using reference = Base&;
+            using pointer = Base*;
+            using iterator_category = std::forward_iterator_tag;
+
+            // Member functions
+            iterator() : mVec{nullptr}, mIndex{0}, mEnd{0} {};
+            iterator(ConcurrentPolyVector* vec, size_t index, size_t end) : mVec{vec}, mIndex{index}, mEnd{end} {
+                skip_abandoned();
+            };
+
+            // operators
+            Base& operator*() const {
+                return (*mVec)[mIndex];
+            }
+
+            iterator& operator++() {
+                ++mIndex;
+                skip_abandoned();
+                return *this;
+            }
+
+            iterator operator++(int) {
+                iterator tmp = *this;
+                ++(*this);
+                return tmp;
+            }
+
+            bool operator==(const iterator other) const {
+                return other.mIndex == mIndex;
+            }
+
+            bool operator!=(const iterator other) const {
+                return other.mIndex != mIndex;
+            }
+
+        private:
+            ConcurrentPolyVector* mVec;
+            size_t mIndex;
+            size_t mEnd;
+
+            void skip_abandoned() {
+                while (mIndex < mEnd && mVec->abandoned(mIndex)) {
+                    ++mIndex;
+                }
+            }
+    };
+
+    // Member functions
+    ConcurrentPolyVector() = default;
+
+    ConcurrentPolyVector(ConcurrentPolyVector& other) = delete;
+    void operator=(ConcurrentPolyVector& other) = delete;
+
+    ConcurrentPolyVector(ConcurrentPolyVector&& other) = delete;
+    void operator=(ConcurrentPolyVector&& other) = delete;
+
+    ~ConcurrentPolyVector();
+
+    // Element access, valid for index < size() unless abandoned(index)
+    Base& operator[](size_t index);
+    Base& front();
+    Base& back();
+    bool abandoned(size_t index);
+
+    // Iterators, over the elements published when begin/end is called, skipping
+    // abandoned slots
+    iterator begin() {
+        size_t published = size();
+        return iterator(this, 0, published);
+    }
+
+    iterator end() {
+        size_t published = size();
+        return iterator(this, published, published);
+    }
+
+    // Capacity
+    size_t size();
+    void reserve(size_t new_capacity);
+    size_t capacity();
+
+    // Modifiers, safe to call concurrently with each other and with readers.
+    // Both return the index of the new element. If the constructor throws, the
+    // slot is abandoned and the exception propagates.
+    size_t push_back(Base value);
+    template <typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base>
+    size_t emplace_back(Args&&... args);
+
+private:
+    static constexpr size_t first_segment_bits = 3;
+    static constexpr size_t first_segment_capacity = size_t{1} << first_segment_bits;
+    static constexpr size_t segment_count = 64 - first_segment_bits;
+
+    // Slot states
+    static constexpr uint8_t empty_ = 0;
+    static constexpr uint8_t ready_ = 1;
+    static constexpr uint8_t abandoned_ = 2;
+
+    struct Segment {
+        Base* data;
+        std::atomic<uint8_t>* state;
+    };
+
+    std::atomic<Segment*> segments_[segment_count] {};
+    std::atomic<size_t> claimed_ {0};
+    std::atomic<size_t> published_ {0};
+
+    static size_t segment_of(size_t index);
+    static size_t segment_capacity(size_t segment);
+    static size_t segment_offset(size_t index, size_t segment);
+
+    Segment* acquire_segment(size_t segment);
+    Base* slot(size_t index);
+    size_t claim();
+    void publish(size_t index, uint8_t state);
+    template <typename Derived, typename... Args>
+    size_t construct(Args&&... args);
+};
+
+// private
+
+template<typename Base, typename Allocator>
+size_t ConcurrentPolyVector<Base, Allocator>::segment_of(size_t index) {
+    return std::bit_width(index + first_segment_capacity) - 1 - first_segment_bits;
+}
+
+template<typename Base, typename Allocator>
+size_t ConcurrentPolyVector<Base, Allocator>::segment_capacity(size_t segment) {
+    return first_segment_capacity << segment;
+}
+
+template<typename Base, typename Allocator>
+size_t ConcurrentPolyVector<Base, Allocator>::segment_offset(size_t index, size_t segment) {
+    return index + first_segment_capacity - segment_capacity(segment);
+}
+
+// Returns the segment, allocating it if needed. Racing allocators agree through
+// a compare-exchange and the losers free their copy.
+template<typename Base, typename Allocator>
+typename ConcurrentPolyVector<Base, Allocator>::Segment*
+ConcurrentPolyVector<Base, Allocator>::acquire_segment(size_t segment) {
+    Segment* current = segments_[segment].load(std::memory_order_acquire);
+    if (current != nullptr) {
+        return current;
+    }
+
+    Allocator allocator;
+    size_t new_capacity = segment_capacity(segment);
+    Segment* fresh = new Segment{allocator.allocate(new_capacity), new std::atomic<uint8_t>[new_capacity]{}};
+    if (segments_[segment].compare_exchange_strong(current, fresh, std::memory_order_acq_rel)) {
+        return fresh;
+    }
+
+    allocator.deallocate(fresh->data, new_capacity);
+    delete[] fresh->state;
+    delete fresh;
+    return current;
+}
+
+template<typename Base, typename Allocator>
+Base* ConcurrentPolyVector<Base, Allocator>::slot(size_t index) {
+    size_t segment = segment_of(index);
+    return acquire_segment(segment)->data + segment_offset(index, segment);
+}
+
+template<typename Base, typename Allocator>
+size_t ConcurrentPolyVector<Base, Allocator>::claim() {
+    return claimed_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Marks the slot constructed or abandoned, then advances the published size
+// across every contiguous finished slot. Any producer finishing a slot helps
+// move the boundary, so a slow producer delays visibility of later slots but
+// never blocks them.
+template<typename Base, typename Allocator>
+void ConcurrentPolyVector<Base, Allocator>::publish(size_t index, uint8_t state) {
+    size_t segment = segment_of(index);
+    segments_[segment].load(std::memory_order_acquire)->state[segment_offset(index, segment)].store(state);
+
+    size_t published = published_.load(std::memory_order_acquire);
+    while (true) {
+        size_t next_segment = segment_of(published);
+        Segment* next = segments_[next_segment].load(std::memory_order_acquire);
+        if (next == nullptr || next->state[segment_offset(published, next_segment)].load() == empty_) {
+            return;
+        }
+        if (published_.compare_exchange_weak(published, published + 1, std::memory_order_acq_rel)) {
+            ++published;
+        }
+    }
+}
+
+// Claims a slot and constructs Derived in it. A throwing constructor leaves
+// nothing in the slot, so it is published abandoned before the exception
+// propagates; otherwise no later slot could ever be published. A failure to
+// allocate the slot's segment still strands the claim.
+template<typename Base, typename Allocator>
+template<typename Derived, typename... Args>
+size_t ConcurrentPolyVector<Base, Allocator>::construct(Args&&... args) {
+    size_t index = claim();
+    Base* target = slot(index);
+    try {
+        new (target) Derived(std::forward<Args>(args)...);
+    }
+    catch (...) {
+        publish(index, abandoned_);
+        throw;
+    }
+    publish(index, ready_);
+    return index;
+}
+
+// Member functions
+
+template<typename Base, typename Allocator>
+ConcurrentPolyVector<Base, Allocator>::~ConcurrentPolyVector() {
+    size_t published = published_.load(std::memory_order_acquire);
+    for (size_t index = 0; index < published; ++index) {
+        if (!abandoned(index)) {
+            (*this)[index].~Base();
+        }
+    }
+
+    Allocator allocator;
+    for (size_t segment = 0; segment < segment_count; ++segment) {
+        Segment* current = segments_[segment].load(std::memory_order_acquire);
+        if (current != nullptr) {
+            allocator.deallocate(current->data, segment_capacity(segment));
+            delete[] current->state;
+            delete current;
+        }
+    }
+}
+
+// Element access
+
+template<typename Base, typename Allocator>
+Base& ConcurrentPolyVector<Base, Allocator>::operator[](size_t index) {
+    size_t segment = segment_of(index);
+    return segments_[segment].load(std::memory_order_acquire)->data[segment_offset(index, segment)];
+}
+
+template<typename Base, typename Allocator>
+Base& ConcurrentPolyVector<Base, Allocator>::front() {
+    return (*this)[0];
+}
+
+template<typename Base, typename Allocator>
+Base& ConcurrentPolyVector<Base, Allocator>::back() {
+    return (*this)[size() - 1];
+}
+
+// True if the constructor for this published slot threw, leaving no element
+template<typename Base, typename Allocator>
+bool ConcurrentPolyVector<Base, Allocator>::abandoned(size_t index) {
+    size_t segment = segment_of(index);
+    return segments_[segment].load(std::memory_order_acquire)->state[segment_offset(index, segment)]
+        .load(std::memory_order_relaxed) == abandoned_;
+}
+
+// Capacity
+
+template<typename Base, typename Allocator>
+size_t ConcurrentPolyVector<Base, Allocator>::size() {
+    return published_.load(std::memory_order_acquire);
+}
+
+template<typename Base, typename Allocator>
+void ConcurrentPolyVector<Base, Allocator>::reserve(size_t new_capacity) {
+    if (new_capacity == 0) {
+        return;
+    }
+    for (size_t segment = 0; segment <= segment_of(new_capacity - 1); ++segment) {
+        acquire_segment(segment);
+    }
+}
+
+template<typename Base, typename Allocator>
+size_t ConcurrentPolyVector<Base, Allocator>::capacity() {
+    size_t total = 0;
+    for (size_t segment = 0; segment < segment_count; ++segment) {
+        if (segments_[segment].load(std::memory_order_acquire) != nullptr) {
+            total += segment_capacity(segment);
+        }
+    }
+    return total;
+}
+
+// Modifiers
+
+template<typename Base, typename Allocator>
+size_t ConcurrentPolyVector<Base, Allocator>::push_back(Base value) {
+    return construct<Base>(value);
+}
+
+template<typename Base, typename Allocator>
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base>
+size_t ConcurrentPolyVector<Base, Allocator>::emplace_back(Args&&... args) {
+    return construct<Derived>(std::forward<Args>(args)...);
+}
+
+#endif
@@ -0,0 +1,171 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "concurrent_polyvector.h"
+
+enum Type {BaseT, DerivedT};
+
+class Base {
+public:
+    static inline std::atomic<int> destructor_count {0};
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+
+    ~Base() {
+        ++destructor_count;
+    };
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+TEST_SUITE_BEGIN("ConcurrentPolyVector");
+TEST_CASE("emplace_back") {
+    ConcurrentPolyVector<Base> vec;
+    CHECK(vec.emplace_back<Base>(1) == 0);
+    CHECK(vec.emplace_back<Derived>(2) == 1);
+
+    CHECK(vec.size() == 2);
+    CHECK(vec[0].get_type() == BaseT);
+    CHECK(vec[1].get_type() == DerivedT);
+    CHECK(vec.front().data == 1);
+    CHECK(vec.back().data == 2);
+}
+
+TEST_CASE("push_back and iteration") {
+    ConcurrentPolyVector<int> vec;
+    for (int i = 0; i < 100; ++i) {
+        vec.push_back(i);
+    }
+
+    int i = 0;
+    for (int item : vec) {
+        CHECK(item == i);
+        ++i;
+    }
+    CHECK(i == 100);
+}
+
+TEST_CASE("Growth does not relocate") {
+    ConcurrentPolyVector<int> vec;
+    vec.push_back(1);
+    int* first = &vec[0];
+
+    for (int i = 0; i < 1000; ++i) {
+        vec.push_back(i);
+    }
+
+    CHECK(&vec[0] == first);
+    CHECK(vec.capacity() >= vec.size());
+}
+
+TEST_CASE("Reserve") {
+    ConcurrentPolyVector<int> vec;
+    vec.reserve(100);
+
+    CHECK(vec.size() == 0);
+    CHECK(vec.capacity() >= 100);
+}
+
+TEST_CASE("Destructor") {
+    Base::destructor_count = 0;
+    {
+        ConcurrentPolyVector<Base> vec;
+        vec.emplace_back<Base>(1);
+        vec.emplace_back<Derived>(2);
+    }
+    CHECK(Base::destructor_count == 2);
+}
+
+class Throwing : public Base {
+public:
+    Throwing(int data_in) : Base(data_in) {
+        throw std::runtime_error("Throwing");
+    };
+};
+
+TEST_CASE("A throwing constructor abandons its slot") {
+    Base::destructor_count = 0;
+    {
+        ConcurrentPolyVector<Base> vec;
+        vec.emplace_back<Base>(1);
+        CHECK_THROWS_AS(vec.emplace_back<Throwing>(2), std::runtime_error);
+        CHECK(vec.emplace_back<Derived>(3) == 2);
+
+        // Later slots are still published
+        CHECK(vec.size() == 3);
+        CHECK(!vec.abandoned(0));
+        CHECK(vec.abandoned(1));
+        CHECK(vec[2].get_type() == DerivedT);
+
+        std::vector<int> data;
+        for (Base& item : vec) {
+            data.push_back(item.data);
+        }
+        CHECK(data == std::vector<int>{1, 3});
+        // The Base subobject of Throwing was already destroyed by the throw
+        CHECK(Base::destructor_count == 1);
+    }
+    CHECK(Base::destructor_count == 3);
+}
+
+TEST_CASE("Concurrent producers") {
+    constexpr int thread_count = 4;
+    constexpr int per_thread = 5000;
+    ConcurrentPolyVector<Base> vec;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&vec, t] {
+            for (int i = 0; i < per_thread; ++i) {
+                if (i % 2 == 0) {
+                    vec.emplace_back<Base>(t * per_thread + i);
+                }
+                else {
+                    vec.emplace_back<Derived>(t * per_thread + i);
+                }
+            }
+        });
+    }
+
+    // Every published element must be fully constructed while producers run
+    bool consistent = true;
+    while (vec.size() < thread_count * per_thread) {
+        size_t size = vec.size();
+        for (size_t index = 0; index < size; ++index) {
+            Base& item = vec[index];
+            consistent &= item.get_type() == (item.data % 2 == 0 ? BaseT : DerivedT);
+        }
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    CHECK(consistent);
+    CHECK(vec.size() == thread_count * per_thread);
+    std::vector<bool> seen(thread_count * per_thread, false);
+    for (Base& item : vec) {
+        seen[item.data] = true;
+    }
+    CHECK(std::find(seen.begin(), seen.end(), false) == seen.end());
+}
+TEST_SUITE_END();
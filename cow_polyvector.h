@@ -0,0 +1,423 @@
+#ifndef COW_POLYVECTOR_H
+#define COW_POLYVECTOR_H
+
+#include <atomic>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "polyvector.h"
+
+// Copy-on-write PolyVector. Elements live in fixed-size, reference-counted
+// chunks. snapshot() shares every chunk with an immutable Snapshot in O(chunks);
+// the writer copies a chunk only the first time it mutates it while shared.
+// Unsharing copies each element with its dynamic type's copy constructor,
+// through a clone hook recorded by vptr when that type is first added, so
+// element types must be copy constructible. Each copy is destroyed by the last
+// owner of its chunk.
+template<typename Base, typename Allocator = std::allocator<Base>, size_t ChunkSize = 1024>
+class CowPolyVector {
+private:
+    struct Chunk {
+        Base* data;
+        size_t size;
+        std::atomic<size_t> refs;
+    };
+
+    static Chunk* new_chunk();
+    static void release(Chunk* chunk);
+
+    // Copy constructs from into the slot at to, as the type it was recorded for
+    using Cloner = void (*)(const Base& from, void* to);
+
+    template<typename Derived>
+    static void clone(const Base& from, void* to) {
+        new (to) Derived(static_cast<const Derived&>(from));
+    }
+
+public:
+    // Member types
+    using value_type = Base;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+    using reference = Base&;
+    using pointer = Base*;
+    class iterator {
+        public:
+            // Member types
+            using difference_type = std::ptrdiff_t;
+            using value_type = Base;
+            using reference = Base&;
+            using pointer = Base*;
+            using iterator_category = std::forward_iterator_tag;
+
+            // Member functions
+            iterator() : mVec{nullptr}, mIndex{0} {};
+            iterator(CowPolyVector* vec, size_t index) : mVec{vec}, mIndex{index} {};
+
+            // operators
+            Base& operator*() const {
+                return (*mVec)[mIndex];
+            }
+
+            iterator& operator++() {
+                ++mIndex;
+                return *this;
+            }
+
+            iterator operator++(int) {
+                iterator tmp = *this;
+                ++(*this);
+                return tmp;
+            }
+
+            bool operator==(const iterator other) const {
+                return other.mIndex == mIndex;
+            }
+
+            bool operator!=(const iterator other) const {
+                return other.mIndex != mIndex;
+            }
+
+        private:
+            CowPolyVector* mVec;
+            size_t mIndex;
+    };
+
+    // Immutable view sharing the writer's chunks at the time it was taken.
+    // Copies are cheap and may be handed to other threads.
+    class Snapshot {
+    public:
+        class iterator {
+            public:
+                // Member types
+                using difference_type = std::ptrdiff_t;
+                using value_type = const Base;
+                using reference = const Base&;
+                using pointer = const Base*;
+                using iterator_category = std::forward_iterator_tag;
+
+                // Member functions
+                iterator() : mSnapshot{nullptr}, mIndex{0} {};
+                iterator(const Snapshot* snapshot, size_t index) : mSnapshot{snapshot}, mIndex{index} {};
+
+                // operators
+                const Base& operator*() const {
+                    return (*mSnapshot)[mIndex];
+                }
+
+                iterator& operator++() {
+                    ++mIndex;
+                    return *this;
+                }
+
+                iterator operator++(int) {
+                    iterator tmp = *this;
+                    ++(*this);
+                    return tmp;
+                }
+
+                bool operator==(const iterator other) const {
+                    return other.mIndex == mIndex;
+                }
+
+                bool operator!=(const iterator other) const {
+                    return other.mIndex != mIndex;
+                }
+
+            private:
+                const Snapshot* mSnapshot;
+                size_t mIndex;
+        };
+
+        Snapshot() = default;
+        Snapshot(const std::vector<Chunk*>& chunks, size_t size);
+        Snapshot(const Snapshot& other);
+        Snapshot& operator=(const Snapshot& other);
+        ~Snapshot();
+
+        const Base& operator[](size_t index) const {
+            return chunks_[index / ChunkSize]->data[index % ChunkSize];
+        }
+
+        iterator begin() const {
+            return iterator(this, 0);
+        }
+
+        iterator end() const {
+            return iterator(this, size_);
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+    private:
+        std::vector<Chunk*> chunks_;
+        size_t size_ {0};
+    };
+
+    // Member functions
+    CowPolyVector() = default;
+
+    CowPolyVector(CowPolyVector& other) = delete;
+    void operator=(CowPolyVector& other) = delete;
+
+    CowPolyVector(CowPolyVector&& other) = delete;
+    void operator=(CowPolyVector&& other) = delete;
+
+    ~CowPolyVector();
+
+    // Element access. The non-const overloads unshare the element's chunk.
+    Base& operator[](size_t index);
+    const Base& operator[](size_t index) const;
+    Base& front();
+    Base& back();
+
+    // Iterators
+    iterator begin() {
+        return iterator(this, 0);
+    }
+
+    iterator end() {
+        return iterator(this, size_);
+    }
+
+    // Capacity
+    size_t size() const;
+    size_t capacity() const;
+
+    // Modifiers
+    void clear();
+    void push_back(Base value);
+    template <typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base> && std::is_copy_constructible_v<Derived>
+    void emplace_back(Args&&... args);
+    void pop_back();
+
+    // Snapshots
+    Snapshot snapshot() const;
+
+private:
+    std::vector<Chunk*> chunks_;
+    size_t size_ {0};
+
+    // Clone hook of each dynamic type added so far, by vptr
+    std::unordered_map<const void*, Cloner> cloners_;
+    const void* last_recorded_ {nullptr};
+
+    Chunk* unshare(size_t chunk_index);
+    Base* append_slot();
+    template<typename Derived>
+    void record_cloner(const Base& item);
+    Cloner cloner_of(const Base& item);
+};
+
+// private
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+typename CowPolyVector<Base, Allocator, ChunkSize>::Chunk*
+CowPolyVector<Base, Allocator, ChunkSize>::new_chunk() {
+    Allocator allocator;
+    return new Chunk{allocator.allocate(ChunkSize), 0, 1};
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+void CowPolyVector<Base, Allocator, ChunkSize>::release(Chunk* chunk) {
+    if (chunk->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    for (size_t index = 0; index < chunk->size; ++index) {
+        chunk->data[index].~Base();
+    }
+    Allocator allocator;
+    allocator.deallocate(chunk->data, ChunkSize);
+    delete chunk;
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+typename CowPolyVector<Base, Allocator, ChunkSize>::Chunk*
+CowPolyVector<Base, Allocator, ChunkSize>::unshare(size_t chunk_index) {
+    Chunk* chunk = chunks_[chunk_index];
+    if (chunk->refs.load(std::memory_order_acquire) == 1) {
+        return chunk;
+    }
+
+    // copy->size counts the clones so far, so a throwing copy constructor
+    // leaves a chunk that releases exactly what was built
+    Chunk* copy = new_chunk();
+    try {
+        for (; copy->size < chunk->size; ++copy->size) {
+            const Base& from = chunk->data[copy->size];
+            cloner_of(from)(from, copy->data + copy->size);
+        }
+    }
+    catch (...) {
+        release(copy);
+        throw;
+    }
+    release(chunk);
+    chunks_[chunk_index] = copy;
+    return copy;
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+template<typename Derived>
+void CowPolyVector<Base, Allocator, ChunkSize>::record_cloner(const Base& item) {
+    if constexpr (std::is_polymorphic_v<Base>) {
+        const void* vptr = vptr_of(item);
+        if (vptr != last_recorded_) {
+            cloners_.try_emplace(vptr, &clone<Derived>);
+            last_recorded_ = vptr;
+        }
+    }
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+typename CowPolyVector<Base, Allocator, ChunkSize>::Cloner
+CowPolyVector<Base, Allocator, ChunkSize>::cloner_of(const Base& item) {
+    if constexpr (std::is_polymorphic_v<Base>) {
+        return cloners_.find(vptr_of(item))->second;
+    }
+    else {
+        return &clone<Base>;
+    }
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+Base* CowPolyVector<Base, Allocator, ChunkSize>::append_slot() {
+    if (size_ == chunks_.size() * ChunkSize) {
+        chunks_.push_back(new_chunk());
+    }
+    Chunk* chunk = unshare(chunks_.size() - 1);
+    return chunk->data + chunk->size;
+}
+
+// Snapshot
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+CowPolyVector<Base, Allocator, ChunkSize>::Snapshot::Snapshot(const std::vector<Chunk*>& chunks, size_t size)
+    : chunks_{chunks}, size_{size} {
+    for (Chunk* chunk : chunks_) {
+        chunk->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+CowPolyVector<Base, Allocator, ChunkSize>::Snapshot::Snapshot(const Snapshot& other)
+    : Snapshot(other.chunks_, other.size_) {}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+typename CowPolyVector<Base, Allocator, ChunkSize>::Snapshot&
+CowPolyVector<Base, Allocator, ChunkSize>::Snapshot::operator=(const Snapshot& other) {
+    for (Chunk* chunk : other.chunks_) {
+        chunk->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    for (Chunk* chunk : chunks_) {
+        release(chunk);
+    }
+    chunks_ = other.chunks_;
+    size_ = other.size_;
+    return *this;
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+CowPolyVector<Base, Allocator, ChunkSize>::Snapshot::~Snapshot() {
+    for (Chunk* chunk : chunks_) {
+        release(chunk);
+    }
+}
+
+// Member functions
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+CowPolyVector<Base, Allocator, ChunkSize>::~CowPolyVector() {
+    clear();
+}
+
+// Element access
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+Base& CowPolyVector<Base, Allocator, ChunkSize>::operator[](size_t index) {
+    return unshare(index / ChunkSize)->data[index % ChunkSize];
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+const Base& CowPolyVector<Base, Allocator, ChunkSize>::operator[](size_t index) const {
+    return chunks_[index / ChunkSize]->data[index % ChunkSize];
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+Base& CowPolyVector<Base, Allocator, ChunkSize>::front() {
+    return (*this)[0];
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+Base& CowPolyVector<Base, Allocator, ChunkSize>::back() {
+    return (*this)[size_ - 1];
+}
+
+// Capacity
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+size_t CowPolyVector<Base, Allocator, ChunkSize>::size() const {
+    return size_;
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+size_t CowPolyVector<Base, Allocator, ChunkSize>::capacity() const {
+    return chunks_.size() * ChunkSize;
+}
+
+// Modifiers
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+void CowPolyVector<Base, Allocator, ChunkSize>::clear() {
+    for (Chunk* chunk : chunks_) {
+        release(chunk);
+    }
+    chunks_.clear();
+    size_ = 0;
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+void CowPolyVector<Base, Allocator, ChunkSize>::push_back(Base value) {
+    Base* item = new (append_slot()) Base{value};
+    record_cloner<Base>(*item);
+    ++chunks_.back()->size;
+    ++size_;
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base> && std::is_copy_constructible_v<Derived>
+void CowPolyVector<Base, Allocator, ChunkSize>::emplace_back(Args&&... args) {
+    Derived* item = new (append_slot()) Derived(std::forward<Args>(args)...);
+    record_cloner<Derived>(*item);
+    ++chunks_.back()->size;
+    ++size_;
+}
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+void CowPolyVector<Base, Allocator, ChunkSize>::pop_back() {
+    if (size_ == 0) {
+        return;
+    }
+    Chunk* chunk = unshare(chunks_.size() - 1);
+    chunk->data[chunk->size - 1].~Base();
+    --chunk->size;
+    --size_;
+    if (chunk->size == 0) {
+        release(chunk);
+        chunks_.pop_back();
+    }
+}
+
+// Snapshots
+
+template<typename Base, typename Allocator, size_t ChunkSize>
+typename CowPolyVector<Base, Allocator, ChunkSize>::Snapshot
+CowPolyVector<Base, Allocator, ChunkSize>::snapshot() const {
+    return Snapshot(chunks_, size_);
+}
+
+#endif
@@ -0,0 +1,216 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <set>
+#include <thread>
+#include <utility>
+#include "cow_polyvector.h"
+
+enum Type {BaseT, DerivedT};
+
+struct Counter {
+    int constructor_count {0};
+    int destructor_count {0};
+};
+
+class Base {
+public:
+    Counter *counter;
+    int data;
+
+    Base(Counter* counter_in, int data_in) : counter{counter_in}, data{data_in} {
+        ++(counter->constructor_count);
+    };
+
+    virtual ~Base() {
+        ++(counter->destructor_count);
+    };
+
+    Base(const Base& other) : counter{other.counter}, data{other.data} {
+        ++(counter->constructor_count);
+    };
+
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() const {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(Counter* counter_in, int data_in) : Base(counter_in, data_in) {};
+    virtual Type get_type() const {
+        return DerivedT;
+    }
+};
+
+// Registers each object it constructs and unregisters it on destruction, so
+// destroying a bitwise copy that was never constructed is caught
+class Owning : public Base {
+public:
+    static inline std::set<const Owning*> live;
+    static inline int unknown_destroyed {0};
+
+    Owning(Counter* counter_in, int data_in) : Base(counter_in, data_in) {
+        live.insert(this);
+    };
+
+    Owning(const Owning& other) : Base(other) {
+        live.insert(this);
+    };
+
+    ~Owning() {
+        unknown_destroyed += live.erase(this) == 0;
+    }
+
+    virtual Type get_type() const {
+        return DerivedT;
+    }
+};
+
+using Vec = CowPolyVector<Base, std::allocator<Base>, 4>;
+
+TEST_SUITE_BEGIN("CowPolyVector");
+TEST_CASE("emplace_back across chunks") {
+    Counter counter;
+    Vec vec;
+    for (int i = 0; i < 10; ++i) {
+        if (i % 2 == 0) {
+            vec.emplace_back<Base>(&counter, i);
+        }
+        else {
+            vec.emplace_back<Derived>(&counter, i);
+        }
+    }
+
+    CHECK(vec.size() == 10);
+    CHECK(vec.capacity() == 12);
+    CHECK(vec[0].get_type() == BaseT);
+    CHECK(vec[9].get_type() == DerivedT);
+    CHECK(vec.back().data == 9);
+
+    int i = 0;
+    for (Base& item : vec) {
+        CHECK(item.data == i);
+        ++i;
+    }
+}
+
+TEST_CASE("Snapshot is isolated from later writes") {
+    Counter counter;
+    Vec vec;
+    for (int i = 0; i < 6; ++i) {
+        vec.emplace_back<Derived>(&counter, i);
+    }
+
+    Vec::Snapshot snap = vec.snapshot();
+    vec[0].data = 100;
+    vec.emplace_back<Base>(&counter, 6);
+    vec.pop_back();
+    vec.pop_back();
+
+    CHECK(snap.size() == 6);
+    int i = 0;
+    for (const Base& item : snap) {
+        CHECK(item.data == i);
+        CHECK(item.get_type() == DerivedT);
+        ++i;
+    }
+    CHECK(vec[0].data == 100);
+    CHECK(vec.size() == 5);
+}
+
+TEST_CASE("Only mutated chunks are copied") {
+    Counter counter;
+    Vec vec;
+    for (int i = 0; i < 8; ++i) {
+        vec.emplace_back<Base>(&counter, i);
+    }
+
+    Vec::Snapshot snap = vec.snapshot();
+    CHECK(&std::as_const(vec)[0] == &snap[0]);
+
+    vec[0].data = 100;
+
+    CHECK(&std::as_const(vec)[0] != &snap[0]);
+    CHECK(&std::as_const(vec)[4] == &snap[4]);
+}
+
+TEST_CASE("Last owner destroys") {
+    Counter counter;
+    {
+        Vec::Snapshot snap;
+        {
+            Vec vec;
+            vec.emplace_back<Base>(&counter, 1);
+            vec.emplace_back<Derived>(&counter, 2);
+            snap = vec.snapshot();
+        }
+        CHECK(counter.destructor_count == 0);
+        CHECK(snap[1].get_type() == DerivedT);
+    }
+    CHECK(counter.destructor_count == 2);
+}
+
+TEST_CASE("Unshared copy is destroyed separately") {
+    Counter counter;
+    {
+        Vec vec;
+        vec.emplace_back<Base>(&counter, 1);
+        {
+            Vec::Snapshot snap = vec.snapshot();
+            vec[0].data = 2;
+        }
+        CHECK(counter.destructor_count == 1);
+        CHECK(counter.constructor_count == 2);
+    }
+    CHECK(counter.destructor_count == 2);
+}
+
+TEST_CASE("Unsharing copies through each type's copy constructor") {
+    Counter counter;
+    Owning::live.clear();
+    Owning::unknown_destroyed = 0;
+    {
+        Vec vec;
+        vec.emplace_back<Owning>(&counter, 1);
+        vec.emplace_back<Derived>(&counter, 2);
+        vec.emplace_back<Owning>(&counter, 3);
+        Vec::Snapshot snap = vec.snapshot();
+
+        vec[0].data = 10;
+        CHECK(snap[0].data == 1);
+        CHECK(vec[1].get_type() == DerivedT);
+        CHECK(Owning::live.size() == 4);
+        CHECK(Owning::live.count(static_cast<const Owning*>(&std::as_const(vec)[2])) == 1);
+        CHECK(counter.constructor_count == 6);
+    }
+    CHECK(counter.destructor_count == 6);
+    CHECK(Owning::live.empty());
+    CHECK(Owning::unknown_destroyed == 0);
+}
+
+TEST_CASE("Snapshot read from another thread") {
+    Counter counter;
+    Vec vec;
+    for (int i = 0; i < 100; ++i) {
+        vec.emplace_back<Base>(&counter, i);
+    }
+
+    Vec::Snapshot snap = vec.snapshot();
+    int sum = 0;
+    std::thread reader([snap, &sum] {
+        for (const Base& item : snap) {
+            sum += item.data;
+        }
+    });
+    for (size_t index = 0; index < vec.size(); ++index) {
+        vec[index].data = 0;
+    }
+    reader.join();
+
+    CHECK(sum == 4950);
+}
+TEST_SUITE_END();
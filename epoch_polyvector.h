@@ -0,0 +1,279 @@
+#ifndef EPOCH_POLYVECTOR_H
+#define EPOCH_POLYVECTOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "polyvector.h"
+
+// Single-writer, many-reader PolyVector. One thread appends; any number of
+// readers scan concurrently through a pinned View. Growth publishes a new buffer
+// and retires the old one, which is freed once every reader that could still be
+// walking it has unpinned. Pinning and reading are wait-free.
+template<typename Base, typename Allocator = std::allocator<Base>, size_t MaxReaders = 64>
+class EpochPolyVector {
+private:
+    struct Buffer {
+        Base* data;
+        size_t capacity;
+        std::atomic<size_t> size;
+    };
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch {0};
+        std::atomic<bool> claimed {false};
+    };
+
+public:
+    // Member types
+    using value_type = Base;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+    using reference = Base&;
+    using pointer = Base*;
+    using iterator = typename PolyVector<Base, Allocator>::iterator;
+
+    // A pinned, consistent prefix of the vector. The buffer it points at is not
+    // freed until the View is destroyed.
+    class View {
+    public:
+        View(ReaderSlot* slot, Base* data, size_t size) : slot_{slot}, data_{data}, size_{size} {};
+
+        View(View& other) = delete;
+        void operator=(View& other) = delete;
+
+        ~View() {
+            slot_->epoch.store(0, std::memory_order_release);
+        }
+
+        Base& operator[](size_t index) {
+            return data_[index];
+        }
+
+        iterator begin() {
+            return iterator(data_);
+        }
+
+        iterator end() {
+            return iterator(data_ + size_);
+        }
+
+        size_t size() {
+            return size_;
+        }
+
+    private:
+        ReaderSlot* slot_;
+        Base* data_;
+        size_t size_;
+    };
+
+    // Owns one of the MaxReaders reader slots. Each reading thread makes its own.
+    class Reader {
+    public:
+        Reader(EpochPolyVector* vec, ReaderSlot* slot) : vec_{vec}, slot_{slot} {};
+
+        Reader(Reader& other) = delete;
+        void operator=(Reader& other) = delete;
+
+        ~Reader() {
+            slot_->claimed.store(false, std::memory_order_release);
+        }
+
+        View pin() {
+            slot_->epoch.store(vec_->epoch_.load());
+            Buffer* buffer = vec_->buffer_.load();
+            if (buffer == nullptr) {
+                return View(slot_, nullptr, 0);
+            }
+            return View(slot_, buffer->data, buffer->size.load(std::memory_order_acquire));
+        }
+
+    private:
+        EpochPolyVector* vec_;
+        ReaderSlot* slot_;
+    };
+
+    // Member functions
+    EpochPolyVector() = default;
+
+    EpochPolyVector(EpochPolyVector& other) = delete;
+    void operator=(EpochPolyVector& other) = delete;
+
+    EpochPolyVector(EpochPolyVector&& other) = delete;
+    void operator=(EpochPolyVector&& other) = delete;
+
+    ~EpochPolyVector();
+
+    // Readers, blocks while all MaxReaders slots are taken
+    Reader make_reader();
+
+    // Writer thread only
+    Base& operator[](size_t index);
+    size_t size();
+    void reserve(size_t new_capacity);
+    size_t capacity();
+    void push_back(Base value);
+    template <typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base>
+    void emplace_back(Args&&... args);
+
+    // Frees retired buffers no reader can still see. Growth calls this already.
+    void reclaim();
+    size_t retired_count();
+
+private:
+    std::atomic<Buffer*> buffer_ {nullptr};
+    std::atomic<uint64_t> epoch_ {1};
+    ReaderSlot readers_[MaxReaders];
+    std::vector<std::pair<Buffer*, uint64_t>> retired_;
+
+    void trusted_reserve(size_t new_capacity);
+    Buffer* expand_if_full();
+    static void free_buffer(Buffer* buffer);
+};
+
+// private
+
+// Bitwise-relocates into a new buffer and publishes it. The old buffer is
+// tagged with the current epoch, then the epoch advances: readers that pin
+// from here on load the new buffer, so the old one is only reachable from
+// readers holding an epoch at or below the tag.
+template<typename Base, typename Allocator, size_t MaxReaders>
+void EpochPolyVector<Base, Allocator, MaxReaders>::trusted_reserve(size_t new_capacity) {
+    Allocator allocator;
+    Buffer* old_buffer = buffer_.load(std::memory_order_relaxed);
+    size_t size = old_buffer == nullptr ? 0 : old_buffer->size.load(std::memory_order_relaxed);
+    Buffer* new_buffer = new Buffer{allocator.allocate(new_capacity), new_capacity, size};
+
+    if (old_buffer != nullptr) {
+        std::memcpy(static_cast<void*>(new_buffer->data), static_cast<void*>(old_buffer->data), sizeof(Base) * size);
+    }
+    buffer_.store(new_buffer);
+
+    if (old_buffer != nullptr) {
+        retired_.emplace_back(old_buffer, epoch_.fetch_add(1));
+        reclaim();
+    }
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+typename EpochPolyVector<Base, Allocator, MaxReaders>::Buffer*
+EpochPolyVector<Base, Allocator, MaxReaders>::expand_if_full() {
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    if (buffer == nullptr || buffer->size.load(std::memory_order_relaxed) == buffer->capacity) {
+        trusted_reserve(buffer == nullptr || buffer->capacity == 0 ? 1 : buffer->capacity * 2);
+        buffer = buffer_.load(std::memory_order_relaxed);
+    }
+    return buffer;
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+void EpochPolyVector<Base, Allocator, MaxReaders>::free_buffer(Buffer* buffer) {
+    Allocator allocator;
+    allocator.deallocate(buffer->data, buffer->capacity);
+    delete buffer;
+}
+
+// Member functions
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+EpochPolyVector<Base, Allocator, MaxReaders>::~EpochPolyVector() {
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    if (buffer != nullptr) {
+        size_t size = buffer->size.load(std::memory_order_relaxed);
+        for (size_t index = 0; index < size; ++index) {
+            buffer->data[index].~Base();
+        }
+        free_buffer(buffer);
+    }
+    for (auto& [retired, epoch] : retired_) {
+        free_buffer(retired);
+    }
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+typename EpochPolyVector<Base, Allocator, MaxReaders>::Reader
+EpochPolyVector<Base, Allocator, MaxReaders>::make_reader() {
+    while (true) {
+        for (ReaderSlot& slot : readers_) {
+            bool expected = false;
+            if (slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                return Reader(this, &slot);
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+Base& EpochPolyVector<Base, Allocator, MaxReaders>::operator[](size_t index) {
+    return buffer_.load(std::memory_order_relaxed)->data[index];
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+size_t EpochPolyVector<Base, Allocator, MaxReaders>::size() {
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    return buffer == nullptr ? 0 : buffer->size.load(std::memory_order_relaxed);
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+void EpochPolyVector<Base, Allocator, MaxReaders>::reserve(size_t new_capacity) {
+    if (new_capacity > capacity()) {
+        trusted_reserve(new_capacity);
+    }
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+size_t EpochPolyVector<Base, Allocator, MaxReaders>::capacity() {
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    return buffer == nullptr ? 0 : buffer->capacity;
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+void EpochPolyVector<Base, Allocator, MaxReaders>::push_back(Base value) {
+    Buffer* buffer = expand_if_full();
+    size_t size = buffer->size.load(std::memory_order_relaxed);
+    new (buffer->data + size) Base{value};
+    buffer->size.store(size + 1, std::memory_order_release);
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base>
+void EpochPolyVector<Base, Allocator, MaxReaders>::emplace_back(Args&&... args) {
+    Buffer* buffer = expand_if_full();
+    size_t size = buffer->size.load(std::memory_order_relaxed);
+    new (buffer->data + size) Derived(std::forward<Args>(args)...);
+    buffer->size.store(size + 1, std::memory_order_release);
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+void EpochPolyVector<Base, Allocator, MaxReaders>::reclaim() {
+    uint64_t oldest = UINT64_MAX;
+    for (ReaderSlot& slot : readers_) {
+        uint64_t pinned = slot.epoch.load();
+        if (pinned != 0 && pinned < oldest) {
+            oldest = pinned;
+        }
+    }
+
+    size_t kept = 0;
+    for (auto& [retired, epoch] : retired_) {
+        if (epoch < oldest) {
+            free_buffer(retired);
+        }
+        else {
+            retired_[kept++] = {retired, epoch};
+        }
+    }
+    retired_.resize(kept);
+}
+
+template<typename Base, typename Allocator, size_t MaxReaders>
+size_t EpochPolyVector<Base, Allocator, MaxReaders>::retired_count() {
+    return retired_.size();
+}
+
+#endif
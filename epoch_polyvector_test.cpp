@@ -0,0 +1,143 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <thread>
+#include <vector>
+#include "epoch_polyvector.h"
+
+enum Type {BaseT, DerivedT};
+
+class Base {
+public:
+    static inline std::atomic<int> destructor_count {0};
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+
+    ~Base() {
+        ++destructor_count;
+    };
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+TEST_SUITE_BEGIN("EpochPolyVector");
+TEST_CASE("emplace_back") {
+    EpochPolyVector<Base> vec;
+    vec.emplace_back<Base>(1);
+    vec.emplace_back<Derived>(2);
+
+    CHECK(vec.size() == 2);
+    CHECK(vec[0].get_type() == BaseT);
+    CHECK(vec[1].get_type() == DerivedT);
+    CHECK(vec[1].data == 2);
+}
+
+TEST_CASE("Empty view") {
+    EpochPolyVector<int> vec;
+    auto reader = vec.make_reader();
+    auto view = reader.pin();
+
+    CHECK(view.size() == 0);
+    CHECK(view.begin() == view.end());
+}
+
+TEST_CASE("Pinned view survives growth") {
+    EpochPolyVector<int> vec;
+    vec.push_back(1);
+    vec.push_back(2);
+    auto reader = vec.make_reader();
+    {
+        auto view = reader.pin();
+        for (int i = 0; i < 100; ++i) {
+            vec.push_back(i);
+        }
+
+        CHECK(vec.retired_count() > 0);
+        CHECK(view.size() == 2);
+        CHECK(view[0] == 1);
+        CHECK(view[1] == 2);
+    }
+
+    vec.reclaim();
+    CHECK(vec.retired_count() == 0);
+
+    auto view = reader.pin();
+    CHECK(view.size() == 102);
+}
+
+TEST_CASE("Unpinned growth reclaims immediately") {
+    EpochPolyVector<int> vec;
+    auto reader = vec.make_reader();
+    for (int i = 0; i < 100; ++i) {
+        vec.push_back(i);
+    }
+
+    CHECK(vec.retired_count() == 0);
+}
+
+TEST_CASE("Destructor") {
+    Base::destructor_count = 0;
+    {
+        EpochPolyVector<Base> vec;
+        vec.emplace_back<Base>(1);
+        vec.emplace_back<Derived>(2);
+        vec.emplace_back<Derived>(3);
+    }
+    CHECK(Base::destructor_count == 3);
+}
+
+TEST_CASE("Concurrent readers") {
+    constexpr int element_count = 20000;
+    EpochPolyVector<Base> vec;
+    std::atomic<bool> done {false};
+    std::atomic<bool> consistent {true};
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&] {
+            auto reader = vec.make_reader();
+            while (!done.load()) {
+                auto view = reader.pin();
+                int index = 0;
+                for (Base& item : view) {
+                    if (item.data != index || item.get_type() != (index % 2 == 0 ? BaseT : DerivedT)) {
+                        consistent = false;
+                    }
+                    ++index;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < element_count; ++i) {
+        if (i % 2 == 0) {
+            vec.emplace_back<Base>(i);
+        }
+        else {
+            vec.emplace_back<Derived>(i);
+        }
+    }
+    done = true;
+    for (auto& thread : readers) {
+        thread.join();
+    }
+
+    CHECK(consistent);
+    CHECK(vec.size() == element_count);
+}
+TEST_SUITE_END();
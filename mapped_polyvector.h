@@ -0,0 +1,364 @@
+#ifndef MAPPED_POLYVECTOR_H
+#define MAPPED_POLYVECTOR_H
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "polyvector_registry.h"
+
+// A PolyVector whose storage is a file mapped with MAP_SHARED, so it can be
+// larger than memory and outlives the process. The file holds a header with
+// size and capacity, the slots, and a type id per slot. open() rewrites every
+// vptr from its type id, so elements written by an earlier process are
+// callable without a deserialize step. Element types must be registered and
+// trivially serializable, as for save() and load().
+//
+// Writes reach the page cache immediately; flush() forces them to disk.
+// Growth is not atomic: a crash while growing can leave the file unreadable.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+class MappedPolyVector {
+public:
+    // Member types
+    using value_type = Base;
+    using size_type = size_t;
+    using reference = Base&;
+    using pointer = Base*;
+    using iterator = typename PolyVector<Base>::iterator;
+
+    // Member functions
+    MappedPolyVector() = default;
+
+    MappedPolyVector(MappedPolyVector& other) = delete;
+    void operator=(MappedPolyVector& other) = delete;
+
+    MappedPolyVector(MappedPolyVector&& other) = delete;
+    void operator=(MappedPolyVector&& other) = delete;
+
+    ~MappedPolyVector();
+
+    // File
+    bool open(const char* path, PolyTypeRegistry<Base>& registry);
+    bool flush();
+    void close();
+    bool is_open();
+
+    // Element access
+    Base& operator[](size_t index);
+    Base& front();
+    Base& back();
+    Base* data();
+
+    // Iterators
+    iterator begin() {
+        return iterator(data_);
+    }
+
+    iterator end() {
+        return iterator(data_ + size());
+    }
+
+    // Capacity
+    size_t size();
+    bool reserve(size_t new_capacity);
+    size_t capacity();
+
+    // Modifiers
+    void clear();
+    template <typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base>
+    bool emplace_back(Args&&... args);
+    void pop_back();
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t slot_size;
+        uint64_t size;
+        uint64_t capacity;
+    };
+
+    static constexpr char magic_[8] = {'P', 'O', 'L', 'Y', 'M', 'A', 'P', '\0'};
+    static constexpr uint32_t version_ = 1;
+    static constexpr size_t slot_offset_ = 64;
+    static_assert(alignof(Base) <= slot_offset_);
+
+    int fd_ {-1};
+    unsigned char* map_ {nullptr};
+    size_t map_bytes_ {0};
+    Header* header_ {nullptr};
+    Base* data_ {nullptr};
+    uint32_t* ids_ {nullptr};
+    PolyTypeRegistry<Base>* registry_ {nullptr};
+    const void* last_vptr_ {nullptr};
+    uint32_t last_id_ {0};
+
+    static size_t file_bytes(size_t capacity) {
+        return slot_offset_ + capacity * (sizeof(Base) + sizeof(uint32_t));
+    }
+
+    // Whether capacity slots and ids fit in bytes, checked by division as
+    // poly_file_fits does
+    static bool fits(size_t capacity, size_t bytes) {
+        return bytes >= slot_offset_ && capacity <= (bytes - slot_offset_) / (sizeof(Base) + sizeof(uint32_t));
+    }
+
+    bool map(size_t bytes);
+    bool fix_vptrs();
+};
+
+// private
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool MappedPolyVector<Base>::map(size_t bytes) {
+    void* map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    map_ = static_cast<unsigned char*>(map);
+    map_bytes_ = bytes;
+    header_ = reinterpret_cast<Header*>(map_);
+    data_ = reinterpret_cast<Base*>(map_ + slot_offset_);
+    ids_ = reinterpret_cast<uint32_t*>(map_ + slot_offset_ + header_->capacity * sizeof(Base));
+    return true;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool MappedPolyVector<Base>::fix_vptrs() {
+    const void* vptr = nullptr;
+    uint32_t last_id = 0;
+    for (size_t index = 0; index < header_->size; ++index) {
+        if (vptr == nullptr || ids_[index] != last_id) {
+            vptr = registry_->find_vptr(ids_[index]);
+            if (vptr == nullptr) {
+                return false;
+            }
+            last_id = ids_[index];
+        }
+        write_vptr(data_ + index, vptr);
+    }
+    return true;
+}
+
+// Member functions
+
+// Elements are left in the file, not destroyed
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+MappedPolyVector<Base>::~MappedPolyVector() {
+    close();
+}
+
+// File
+
+// Opens or creates the file at path. Returns false if it can't be mapped, was
+// written for a different slot size, or holds a type id the registry lacks.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool MappedPolyVector<Base>::open(const char* path, PolyTypeRegistry<Base>& registry) {
+    close();
+    fd_ = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        return false;
+    }
+    registry_ = &registry;
+
+    struct stat info;
+    bool ok = fstat(fd_, &info) == 0;
+    bool created = ok && info.st_size == 0;
+    if (created) {
+        ok = ftruncate(fd_, file_bytes(0)) == 0 && map(file_bytes(0));
+        if (ok) {
+            std::memcpy(header_->magic, magic_, sizeof(magic_));
+            header_->version = version_;
+            header_->slot_size = sizeof(Base);
+        }
+    }
+    else if (ok && static_cast<size_t>(info.st_size) >= sizeof(Header)) {
+        ok = map(info.st_size)
+            && std::memcmp(header_->magic, magic_, sizeof(magic_)) == 0
+            && header_->version == version_
+            && header_->slot_size == sizeof(Base)
+            && header_->size <= header_->capacity
+            && fits(header_->capacity, map_bytes_)
+            && fix_vptrs();
+    }
+    else {
+        ok = false;
+    }
+
+    if (!ok) {
+        close();
+    }
+    return ok;
+}
+
+// Blocks until every change so far is on disk
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool MappedPolyVector<Base>::flush() {
+    return map_ != nullptr && msync(map_, map_bytes_, MS_SYNC) == 0;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+void MappedPolyVector<Base>::close() {
+    if (map_ != nullptr) {
+        munmap(map_, map_bytes_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    map_ = nullptr;
+    map_bytes_ = 0;
+    header_ = nullptr;
+    data_ = nullptr;
+    ids_ = nullptr;
+    last_vptr_ = nullptr;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool MappedPolyVector<Base>::is_open() {
+    return map_ != nullptr;
+}
+
+// Element access
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+Base& MappedPolyVector<Base>::operator[](size_t index) {
+    return data_[index];
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+Base& MappedPolyVector<Base>::front() {
+    return data_[0];
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+Base& MappedPolyVector<Base>::back() {
+    return data_[size() - 1];
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+Base* MappedPolyVector<Base>::data() {
+    return data_;
+}
+
+// Capacity
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+size_t MappedPolyVector<Base>::size() {
+    return header_ == nullptr ? 0 : header_->size;
+}
+
+// Grows the file and remaps it, moving the type id column to its new offset
+// after the slots. Invalidates references to elements.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool MappedPolyVector<Base>::reserve(size_t new_capacity) {
+    if (map_ == nullptr) {
+        return false;
+    }
+    if (new_capacity <= header_->capacity) {
+        return true;
+    }
+    if (!fits(new_capacity, SIZE_MAX)) {
+        return false;
+    }
+
+    size_t old_capacity = header_->capacity;
+    munmap(map_, map_bytes_);
+    map_ = nullptr;
+    if (ftruncate(fd_, file_bytes(new_capacity)) != 0 || !map(file_bytes(new_capacity))) {
+        close();
+        return false;
+    }
+    uint32_t* new_ids = reinterpret_cast<uint32_t*>(map_ + slot_offset_ + new_capacity * sizeof(Base));
+    std::memmove(new_ids, ids_, sizeof(uint32_t) * old_capacity);
+    ids_ = new_ids;
+    header_->capacity = new_capacity;
+    return true;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+size_t MappedPolyVector<Base>::capacity() {
+    return header_ == nullptr ? 0 : header_->capacity;
+}
+
+// Modifiers
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+void MappedPolyVector<Base>::clear() {
+    for (size_t index = 0; index < size(); ++index) {
+        data_[index].~Base();
+    }
+    if (header_ != nullptr) {
+        header_->size = 0;
+    }
+}
+
+// Returns false, leaving the vector unchanged, if Derived is not registered or
+// the file can't grow. When the file is full the element is built in a buffer
+// first, so an unregistered type is refused before the file grows, and then
+// relocated bitwise into its slot as reserve() relocates elements.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base>
+bool MappedPolyVector<Base>::emplace_back(Args&&... args) {
+    if (map_ == nullptr) {
+        return false;
+    }
+    size_t index = header_->size;
+    bool full = index == header_->capacity;
+    alignas(Derived) unsigned char buffer[sizeof(Derived)];
+
+    Derived* item = new (full ? static_cast<void*>(buffer) : static_cast<void*>(data_ + index))
+        Derived(std::forward<Args>(args)...);
+    const void* vptr = vptr_of<Base>(*item);
+    if (vptr != last_vptr_) {
+        std::optional<uint32_t> id = registry_->find_id(vptr);
+        if (!id) {
+            item->~Derived();
+            return false;
+        }
+        last_vptr_ = vptr;
+        last_id_ = *id;
+    }
+    if (full) {
+        if (!reserve(index == 0 ? 1 : index * 2)) {
+            item->~Derived();
+            return false;
+        }
+        std::memcpy(static_cast<void*>(data_ + index), buffer, sizeof(Derived));
+    }
+    ids_[index] = last_id_;
+    header_->size = index + 1;
+    return true;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+void MappedPolyVector<Base>::pop_back() {
+    if (size() > 0) {
+        data_[header_->size - 1].~Base();
+        header_->size--;
+    }
+}
+
+#endif
@@ -0,0 +1,238 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "mapped_polyvector.h"
+
+enum Type {BaseT, DerivedT, UnregisteredT};
+
+class Base {
+public:
+    static inline int destructor_count = 0;
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+
+    ~Base() {
+        ++destructor_count;
+    };
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+class Unregistered : public Base {
+public:
+    Unregistered(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return UnregisteredT;
+    }
+};
+
+static std::string temp_path(const char* name) {
+    std::string path = (std::filesystem::temp_directory_path() / name).string();
+    std::filesystem::remove(path);
+    return path;
+}
+
+static void register_types(PolyTypeRegistry<Base>& registry) {
+    registry.add<Base>(1, 0);
+    registry.add<Derived>(2, 0);
+}
+
+TEST_SUITE_BEGIN("MappedPolyVector");
+TEST_CASE("emplace_back and growth") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("mapped_polyvector_growth.bin");
+
+    MappedPolyVector<Base> vec;
+    CHECK(vec.open(path.c_str(), registry));
+    CHECK(vec.size() == 0);
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 2 == 0) {
+            CHECK(vec.emplace_back<Base>(i));
+        }
+        else {
+            CHECK(vec.emplace_back<Derived>(i));
+        }
+    }
+    CHECK(vec.size() == 1000);
+    CHECK(vec.capacity() >= 1000);
+
+    int index = 0;
+    bool intact = true;
+    for (Base& item : vec) {
+        intact &= item.data == index && item.get_type() == (index % 2 == 0 ? BaseT : DerivedT);
+        ++index;
+    }
+    CHECK(intact);
+    CHECK(vec.flush());
+    vec.close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Reopen restores elements") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("mapped_polyvector_reopen.bin");
+    {
+        MappedPolyVector<Base> vec;
+        CHECK(vec.open(path.c_str(), registry));
+        for (int i = 0; i < 100; ++i) {
+            if (i % 3 == 0) {
+                vec.emplace_back<Derived>(i);
+            }
+            else {
+                vec.emplace_back<Base>(i);
+            }
+        }
+        Base::destructor_count = 0;
+    }
+    CHECK(Base::destructor_count == 0);
+
+    // Scribble over every vptr, as if written by another build of the program
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        for (int i = 0; i < 100; ++i) {
+            file.seekp(64 + i * sizeof(Base));
+            const void* garbage = reinterpret_cast<const void*>(0x1234);
+            file.write(reinterpret_cast<const char*>(&garbage), sizeof(garbage));
+        }
+    }
+
+    MappedPolyVector<Base> vec;
+    CHECK(vec.open(path.c_str(), registry));
+    CHECK(vec.size() == 100);
+    bool intact = true;
+    for (int i = 0; i < 100; ++i) {
+        intact &= vec[i].data == i && vec[i].get_type() == (i % 3 == 0 ? DerivedT : BaseT);
+    }
+    CHECK(intact);
+
+    CHECK(vec.emplace_back<Derived>(100));
+    CHECK(vec.back().get_type() == DerivedT);
+    vec.close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("pop_back and clear") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("mapped_polyvector_clear.bin");
+
+    MappedPolyVector<Base> vec;
+    CHECK(vec.open(path.c_str(), registry));
+    vec.emplace_back<Base>(1);
+    vec.emplace_back<Derived>(2);
+    vec.emplace_back<Derived>(3);
+
+    Base::destructor_count = 0;
+    vec.pop_back();
+    CHECK(Base::destructor_count == 1);
+    CHECK(vec.size() == 2);
+    vec.clear();
+    CHECK(Base::destructor_count == 3);
+    CHECK(vec.size() == 0);
+    vec.close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Unregistered type is rejected") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("mapped_polyvector_unregistered.bin");
+
+    MappedPolyVector<Base> vec;
+    CHECK(vec.open(path.c_str(), registry));
+    vec.emplace_back<Base>(1);
+    Base::destructor_count = 0;
+    CHECK(!vec.emplace_back<Unregistered>(2));
+    CHECK(Base::destructor_count == 1);
+    CHECK(vec.size() == 1);
+
+    // Refused before a full file grows
+    CHECK(vec.capacity() == 1);
+    CHECK(std::filesystem::file_size(path) == 64 + sizeof(Base) + sizeof(uint32_t));
+    CHECK(!vec.emplace_back<Unregistered>(3));
+    CHECK(vec.capacity() == 1);
+    CHECK(std::filesystem::file_size(path) == 64 + sizeof(Base) + sizeof(uint32_t));
+
+    CHECK(vec.emplace_back<Derived>(4));
+    CHECK(vec.capacity() == 2);
+    CHECK(vec[1].get_type() == DerivedT);
+    CHECK(vec[1].data == 4);
+    vec.close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Open failures") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("mapped_polyvector_failure.bin");
+    {
+        MappedPolyVector<Base> vec;
+        CHECK(vec.open(path.c_str(), registry));
+        vec.emplace_back<Derived>(1);
+    }
+
+    MappedPolyVector<Base> vec;
+    PolyTypeRegistry<Base> partial;
+    partial.add<Base>(1, 0);
+    CHECK(!vec.open(path.c_str(), partial));
+    CHECK(!vec.is_open());
+    CHECK(vec.size() == 0);
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << "not a mapped polyvector file, just some text";
+    }
+    CHECK(!vec.open(path.c_str(), registry));
+    CHECK(!vec.emplace_back<Base>(1));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Open rejects a capacity past the file") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("mapped_polyvector_capacity.bin");
+    {
+        MappedPolyVector<Base> vec;
+        CHECK(vec.open(path.c_str(), registry));
+        vec.emplace_back<Derived>(1);
+    }
+
+    // Capacity follows the magic, version, slot size and size. 2^62 + 1 slots
+    // of 16 bytes plus their ids wrap around to a few bytes.
+    auto set_capacity = [&](uint64_t capacity) {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(24);
+        file.write(reinterpret_cast<const char*>(&capacity), sizeof(capacity));
+    };
+    MappedPolyVector<Base> vec;
+    set_capacity((uint64_t{1} << 62) + 1);
+    CHECK(!vec.open(path.c_str(), registry));
+    set_capacity(2);
+    CHECK(!vec.open(path.c_str(), registry));
+    set_capacity(1);
+    CHECK(vec.open(path.c_str(), registry));
+    CHECK(vec[0].data == 1);
+    vec.close();
+    std::filesystem::remove(path);
+}
+TEST_SUITE_END();
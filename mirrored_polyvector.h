@@ -0,0 +1,268 @@
+#ifndef MIRRORED_POLYVECTOR_H
+#define MIRRORED_POLYVECTOR_H
+
+#include <span>
+#include <tuple>
+#include <vector>
+#include "polyvector.h"
+
+template<typename Member>
+struct member_traits;
+
+template<typename Class, typename Field>
+struct member_traits<Field Class::*> {
+    using class_type = Class;
+    using field_type = Field;
+};
+
+template<auto A, auto B>
+constexpr bool same_member = false;
+
+template<auto A>
+constexpr bool same_member<A, A> = true;
+
+// A PolyVector that mirrors chosen Base fields, given as member pointers, into
+// one contiguous column each. The columns are kept in sync by every modifier,
+// so a scan over one field reads a dense array instead of striding across
+// whole slots, and compilers can vectorize it.
+//
+// Writing a mirrored field through an element leaves its column stale until
+// refresh(). Writing through mutable_column() leaves the elements stale until
+// commit(). set() updates both.
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+class MirroredPolyVector {
+public:
+    // Member types
+    using value_type = Base;
+    using size_type = size_t;
+    using reference = Base&;
+    using pointer = Base*;
+    using iterator = typename PolyVector<Base>::iterator;
+
+    template<auto Field>
+    using field_type = typename member_traits<decltype(Field)>::field_type;
+
+    // Member functions
+    MirroredPolyVector() = default;
+
+    MirroredPolyVector(MirroredPolyVector& other) = delete;
+    void operator=(MirroredPolyVector& other) = delete;
+
+    MirroredPolyVector(MirroredPolyVector&& other) = delete;
+    void operator=(MirroredPolyVector&& other) = delete;
+
+    // Element access
+    Base& operator[](size_t index);
+    Base& front();
+    Base& back();
+    Base* data();
+
+    // Iterators
+    iterator begin() {
+        return elements_.begin();
+    }
+
+    iterator end() {
+        return elements_.end();
+    }
+
+    // Columns
+    template<auto Field>
+    std::span<const field_type<Field>> column();
+    template<auto Field>
+    std::span<field_type<Field>> mutable_column();
+    template<auto Field>
+    void set(size_t index, const field_type<Field>& value);
+    template<auto Field>
+    void commit();
+    void refresh();
+
+    // Capacity
+    size_t size();
+    void reserve(size_t new_capacity);
+    size_t capacity();
+
+    // Modifiers
+    void clear();
+    void insert(const iterator pos, const Base& value);
+    void erase_value(const Base& value);
+    void push_back(const Base& value);
+    template <typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base>
+    void emplace_back(Args&&... args);
+    void pop_back();
+
+private:
+    PolyVector<Base> elements_;
+    std::tuple<std::vector<field_type<Fields>>...> columns_;
+
+    template<auto Field>
+    static constexpr size_t column_index = [] {
+        constexpr bool matches[] = {same_member<Field, Fields>...};
+        for (size_t index = 0; index < sizeof...(Fields); ++index) {
+            if (matches[index]) {
+                return index;
+            }
+        }
+        return sizeof...(Fields);
+    }();
+
+    template<auto Field>
+    std::vector<field_type<Field>>& column_vector() {
+        static_assert(column_index<Field> < sizeof...(Fields), "field is not mirrored");
+        return std::get<column_index<Field>>(columns_);
+    }
+};
+
+// Element access
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+Base& MirroredPolyVector<Base, Fields...>::operator[](size_t index) {
+    return elements_[index];
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+Base& MirroredPolyVector<Base, Fields...>::front() {
+    return elements_.front();
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+Base& MirroredPolyVector<Base, Fields...>::back() {
+    return elements_.back();
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+Base* MirroredPolyVector<Base, Fields...>::data() {
+    return elements_.data();
+}
+
+// Columns
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+template<auto Field>
+std::span<const typename MirroredPolyVector<Base, Fields...>::template field_type<Field>>
+MirroredPolyVector<Base, Fields...>::column() {
+    return column_vector<Field>();
+}
+
+// Writes here reach the elements on commit<Field>()
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+template<auto Field>
+std::span<typename MirroredPolyVector<Base, Fields...>::template field_type<Field>>
+MirroredPolyVector<Base, Fields...>::mutable_column() {
+    return column_vector<Field>();
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+template<auto Field>
+void MirroredPolyVector<Base, Fields...>::set(size_t index, const field_type<Field>& value) {
+    elements_[index].*Field = value;
+    column_vector<Field>()[index] = value;
+}
+
+// Copies a column written through mutable_column() back into the elements
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+template<auto Field>
+void MirroredPolyVector<Base, Fields...>::commit() {
+    std::vector<field_type<Field>>& column = column_vector<Field>();
+    for (size_t index = 0; index < column.size(); ++index) {
+        elements_[index].*Field = column[index];
+    }
+}
+
+// Rereads every column from the elements, after fields were written through
+// element references
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+void MirroredPolyVector<Base, Fields...>::refresh() {
+    auto reread = [this](auto& column, auto field) {
+        column.resize(elements_.size());
+        for (size_t index = 0; index < column.size(); ++index) {
+            column[index] = elements_[index].*field;
+        }
+    };
+    (reread(column_vector<Fields>(), Fields), ...);
+}
+
+// Capacity
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+size_t MirroredPolyVector<Base, Fields...>::size() {
+    return elements_.size();
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+void MirroredPolyVector<Base, Fields...>::reserve(size_t new_capacity) {
+    elements_.reserve(new_capacity);
+    (column_vector<Fields>().reserve(new_capacity), ...);
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+size_t MirroredPolyVector<Base, Fields...>::capacity() {
+    return elements_.capacity();
+}
+
+// Modifiers
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+void MirroredPolyVector<Base, Fields...>::clear() {
+    elements_.clear();
+    (column_vector<Fields>().clear(), ...);
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+void MirroredPolyVector<Base, Fields...>::insert(const iterator pos, const Base& value) {
+    size_t offset = pos - elements_.begin();
+    elements_.insert(pos, value);
+    (column_vector<Fields>().insert(column_vector<Fields>().begin() + offset, value.*Fields), ...);
+}
+
+// Removed elements may be anywhere, so the columns are reread
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+void MirroredPolyVector<Base, Fields...>::erase_value(const Base& value) {
+    elements_.erase_value(value);
+    refresh();
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+void MirroredPolyVector<Base, Fields...>::push_back(const Base& value) {
+    elements_.push_back(value);
+    (column_vector<Fields>().push_back(value.*Fields), ...);
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base>
+void MirroredPolyVector<Base, Fields...>::emplace_back(Args&&... args) {
+    elements_.template emplace_back<Derived>(std::forward<Args>(args)...);
+    Base& item = elements_.back();
+    (column_vector<Fields>().push_back(item.*Fields), ...);
+}
+
+template<typename Base, auto... Fields>
+requires (std::is_same_v<typename member_traits<decltype(Fields)>::class_type, Base> && ...)
+void MirroredPolyVector<Base, Fields...>::pop_back() {
+    if (elements_.size() > 0) {
+        elements_.pop_back();
+        (column_vector<Fields>().pop_back(), ...);
+    }
+}
+
+#endif
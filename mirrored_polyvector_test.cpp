@@ -0,0 +1,123 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <numeric>
+#include "mirrored_polyvector.h"
+
+enum Type {BaseT, DerivedT};
+
+class Base {
+public:
+    int data;
+    float weight;
+
+    Base(int data_in, float weight_in) : data{data_in}, weight{weight_in} {};
+
+    Base(const Base& other) : data{other.data}, weight{other.weight} {};
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    bool operator==(const Base& other) const {
+        return data == other.data;
+    }
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in, float weight_in) : Base(data_in, weight_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+using Vector = MirroredPolyVector<Base, &Base::data, &Base::weight>;
+
+static bool in_sync(Vector& vec) {
+    bool same = vec.column<&Base::data>().size() == vec.size() && vec.column<&Base::weight>().size() == vec.size();
+    for (size_t index = 0; same && index < vec.size(); ++index) {
+        same = vec.column<&Base::data>()[index] == vec[index].data
+            && vec.column<&Base::weight>()[index] == vec[index].weight;
+    }
+    return same;
+}
+
+TEST_SUITE_BEGIN("MirroredPolyVector");
+TEST_CASE("emplace_back keeps columns in sync") {
+    Vector vec;
+    for (int i = 0; i < 100; ++i) {
+        if (i % 2 == 0) {
+            vec.emplace_back<Base>(i, i * 0.5f);
+        }
+        else {
+            vec.emplace_back<Derived>(i, i * 0.5f);
+        }
+    }
+    CHECK(vec.size() == 100);
+    CHECK(in_sync(vec));
+    CHECK(vec[1].get_type() == DerivedT);
+
+    std::span<const int> data = vec.column<&Base::data>();
+    CHECK(std::accumulate(data.begin(), data.end(), 0) == 4950);
+}
+
+TEST_CASE("Modifiers") {
+    Vector vec;
+    vec.reserve(8);
+    vec.emplace_back<Base>(1, 1.0f);
+    vec.emplace_back<Derived>(2, 2.0f);
+    vec.emplace_back<Base>(3, 3.0f);
+    vec.emplace_back<Derived>(2, 4.0f);
+
+    vec.pop_back();
+    CHECK(vec.size() == 3);
+    CHECK(in_sync(vec));
+
+    vec.insert(vec.begin() + 1, Base(7, 7.0f));
+    CHECK(vec[1].data == 7);
+    CHECK(vec.column<&Base::data>()[1] == 7);
+    CHECK(in_sync(vec));
+
+    vec.push_back(Base(9, 9.0f));
+    CHECK(vec.size() == 5);
+    CHECK(vec.back().get_type() == BaseT);
+    CHECK(vec.column<&Base::weight>()[4] == 9.0f);
+    CHECK(in_sync(vec));
+
+    vec.erase_value(Base(2, 0.0f));
+    CHECK(vec.size() == 4);
+    CHECK(in_sync(vec));
+
+    vec.clear();
+    CHECK(vec.size() == 0);
+    CHECK(in_sync(vec));
+}
+
+TEST_CASE("Writing through columns and elements") {
+    Vector vec;
+    for (int i = 0; i < 10; ++i) {
+        vec.emplace_back<Derived>(i, 0.0f);
+    }
+
+    vec.set<&Base::weight>(3, 9.0f);
+    CHECK(vec[3].weight == 9.0f);
+    CHECK(in_sync(vec));
+
+    for (int& data : vec.mutable_column<&Base::data>()) {
+        data *= 2;
+    }
+    CHECK(vec[5].data == 5);
+    vec.commit<&Base::data>();
+    CHECK(vec[5].data == 10);
+    CHECK(in_sync(vec));
+
+    vec[4].weight = 2.5f;
+    CHECK(!in_sync(vec));
+    vec.refresh();
+    CHECK(vec.column<&Base::weight>()[4] == 2.5f);
+    CHECK(in_sync(vec));
+}
+TEST_SUITE_END();
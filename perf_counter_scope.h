@@ -0,0 +1,156 @@
+#ifndef PERF_COUNTER_SCOPE_H
+#define PERF_COUNTER_SCOPE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define POLYVECTOR_PERF_EVENTS 1
+#else
+#define POLYVECTOR_PERF_EVENTS 0
+#endif
+
+// Hardware performance counters for the calling thread, read with Linux
+// perf_event_open. Each counter is opened on its own, so any the kernel or
+// the machine refuses (containers, virtual machines without a PMU, a strict
+// perf_event_paranoid) are left out and the rest still count. If the PMU has
+// fewer counters than requested, the kernel multiplexes them and the totals
+// are scaled up by the fraction of time each one ran.
+class PerfCounters {
+public:
+    PerfCounters() {
+#if POLYVECTOR_PERF_EVENTS
+        counters_ = {
+            {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {"l1d_misses", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+            {"llc_misses", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL)},
+            {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {"dtlb_misses", PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+            {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        };
+        for (Counter& counter : counters_) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = counter.type;
+            attr.config = counter.config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            counter.fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    PerfCounters(PerfCounters& other) = delete;
+    void operator=(PerfCounters& other) = delete;
+
+    PerfCounters(PerfCounters&& other) = delete;
+    void operator=(PerfCounters&& other) = delete;
+
+    ~PerfCounters() {
+#if POLYVECTOR_PERF_EVENTS
+        for (Counter& counter : counters_) {
+            if (counter.fd >= 0) {
+                close(counter.fd);
+            }
+        }
+#endif
+    }
+
+    // True if at least one counter could be opened
+    bool available() {
+        for (Counter& counter : counters_) {
+            if (counter.fd >= 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void start() {
+#if POLYVECTOR_PERF_EVENTS
+        for (Counter& counter : counters_) {
+            if (counter.fd >= 0) {
+                ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // Adds the counts since start() to the totals
+    void stop() {
+#if POLYVECTOR_PERF_EVENTS
+        for (Counter& counter : counters_) {
+            if (counter.fd >= 0) {
+                ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (Counter& counter : counters_) {
+            uint64_t values[3];
+            if (counter.fd >= 0 && read(counter.fd, values, sizeof(values)) == sizeof(values) && values[2] > 0) {
+                counter.total += static_cast<double>(values[0]) * values[1] / values[2];
+            }
+        }
+#endif
+    }
+
+    // Totals of the open counters divided by operations, then zeroes them
+    std::vector<std::pair<std::string, double>> take(double operations) {
+        std::vector<std::pair<std::string, double>> totals;
+        for (Counter& counter : counters_) {
+            if (counter.fd >= 0) {
+                totals.emplace_back(counter.name, counter.total / operations);
+            }
+            counter.total = 0;
+        }
+        return totals;
+    }
+
+private:
+    struct Counter {
+        const char* name;
+        uint32_t type;
+        uint64_t config;
+        int fd {-1};
+        double total {0};
+    };
+
+    std::vector<Counter> counters_;
+
+#if POLYVECTOR_PERF_EVENTS
+    static constexpr uint64_t cache_miss(uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+#endif
+};
+
+// Counts into counters from construction to destruction
+class PerfCounterScope {
+public:
+    PerfCounterScope(PerfCounters& counters) : counters_{counters} {
+        counters_.start();
+    }
+
+    PerfCounterScope(PerfCounterScope& other) = delete;
+    void operator=(PerfCounterScope& other) = delete;
+
+    ~PerfCounterScope() {
+        counters_.stop();
+    }
+
+private:
+    PerfCounters& counters_;
+};
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef POLYRINGBUFFER_H
+#define POLYRINGBUFFER_H
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include "polyvector.h"
+
+enum class RingMode {spsc, mpmc};
+
+// Bounded queue of polymorphic messages stored in place, one same-size slot per
+// message. try_emplace constructs a Derived directly in the slot and consume
+// hands it to the caller as Base& before destroying it in place.
+// RingMode::spsc is wait-free for one producer and one consumer thread.
+// RingMode::mpmc is lock-free for any number of both, using a per-slot sequence
+// number (Vyukov's bounded queue).
+template<typename Base, size_t Capacity, RingMode Mode = RingMode::spsc>
+class PolyRingBuffer {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Member types
+    using value_type = Base;
+    using size_type = size_t;
+    using reference = Base&;
+    using pointer = Base*;
+
+    // Member functions
+    PolyRingBuffer();
+
+    PolyRingBuffer(PolyRingBuffer& other) = delete;
+    void operator=(PolyRingBuffer& other) = delete;
+
+    PolyRingBuffer(PolyRingBuffer&& other) = delete;
+    void operator=(PolyRingBuffer&& other) = delete;
+
+    ~PolyRingBuffer();
+
+    // Capacity
+    size_t size();
+    constexpr size_t capacity() {
+        return Capacity;
+    }
+
+    // Modifiers, returning false when full or empty
+    bool try_push(Base value);
+    template <typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base>
+    bool try_emplace(Args&&... args);
+    template <typename F>
+    bool consume(F&& f);
+
+private:
+    static constexpr size_t mask = Capacity - 1;
+
+    struct SpscSlot {
+        alignas(Base) unsigned char storage[sizeof(Base)];
+    };
+
+    struct MpmcSlot {
+        std::atomic<size_t> sequence;
+        alignas(Base) unsigned char storage[sizeof(Base)];
+    };
+
+    using Slot = std::conditional_t<Mode == RingMode::spsc, SpscSlot, MpmcSlot>;
+
+    // Producer side, then consumer side, each on its own cache line.
+    // The cached positions are only used in spsc mode.
+    alignas(64) std::atomic<size_t> tail_ {0};
+    size_t cached_head_ {0};
+    alignas(64) std::atomic<size_t> head_ {0};
+    size_t cached_tail_ {0};
+    alignas(64) Slot slots_[Capacity];
+
+    static Base* element(Slot& slot) {
+        return std::launder(reinterpret_cast<Base*>(slot.storage));
+    }
+
+    bool claim(size_t& position);
+    void publish(size_t position);
+};
+
+// private
+
+// Claims the position of the next message, returning false when full.
+template<typename Base, size_t Capacity, RingMode Mode>
+bool PolyRingBuffer<Base, Capacity, Mode>::claim(size_t& position) {
+    position = tail_.load(std::memory_order_relaxed);
+    if constexpr (Mode == RingMode::spsc) {
+        if (position - cached_head_ == Capacity) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (position - cached_head_ == Capacity) {
+                return false;
+            }
+        }
+        return true;
+    }
+    else {
+        while (true) {
+            size_t sequence = slots_[position & mask].sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence - position);
+            if (difference == 0) {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+// Makes the message at a claimed position visible to consumers.
+template<typename Base, size_t Capacity, RingMode Mode>
+void PolyRingBuffer<Base, Capacity, Mode>::publish(size_t position) {
+    if constexpr (Mode == RingMode::spsc) {
+        tail_.store(position + 1, std::memory_order_release);
+    }
+    else {
+        slots_[position & mask].sequence.store(position + 1, std::memory_order_release);
+    }
+}
+
+// Member functions
+
+template<typename Base, size_t Capacity, RingMode Mode>
+PolyRingBuffer<Base, Capacity, Mode>::PolyRingBuffer() {
+    if constexpr (Mode == RingMode::mpmc) {
+        for (size_t index = 0; index < Capacity; ++index) {
+            slots_[index].sequence.store(index, std::memory_order_relaxed);
+        }
+    }
+}
+
+// Destroys the messages still queued. No producer or consumer may be running.
+template<typename Base, size_t Capacity, RingMode Mode>
+PolyRingBuffer<Base, Capacity, Mode>::~PolyRingBuffer() {
+    while (consume([](Base&) {})) {}
+}
+
+// Capacity
+
+template<typename Base, size_t Capacity, RingMode Mode>
+size_t PolyRingBuffer<Base, Capacity, Mode>::size() {
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+}
+
+// Modifiers
+
+template<typename Base, size_t Capacity, RingMode Mode>
+bool PolyRingBuffer<Base, Capacity, Mode>::try_push(Base value) {
+    size_t position;
+    if (!claim(position)) {
+        return false;
+    }
+    new (slots_[position & mask].storage) Base{value};
+    publish(position);
+    return true;
+}
+
+template<typename Base, size_t Capacity, RingMode Mode>
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base>
+bool PolyRingBuffer<Base, Capacity, Mode>::try_emplace(Args&&... args) {
+    size_t position;
+    if (!claim(position)) {
+        return false;
+    }
+    new (slots_[position & mask].storage) Derived(std::forward<Args>(args)...);
+    publish(position);
+    return true;
+}
+
+// Calls f with the oldest message, then destroys it and frees its slot.
+template<typename Base, size_t Capacity, RingMode Mode>
+template<typename F>
+bool PolyRingBuffer<Base, Capacity, Mode>::consume(F&& f) {
+    if constexpr (Mode == RingMode::spsc) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return false;
+            }
+        }
+        Base* item = element(slots_[head & mask]);
+        f(*item);
+        item->~Base();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    else {
+        size_t head = head_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots_[head & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence - (head + 1));
+            if (difference == 0) {
+                if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                head = head_.load(std::memory_order_relaxed);
+            }
+        }
+        Base* item = element(*slot);
+        f(*item);
+        item->~Base();
+        slot->sequence.store(head + Capacity, std::memory_order_release);
+        return true;
+    }
+}
+
+#endif
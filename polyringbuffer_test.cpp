@@ -0,0 +1,151 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <thread>
+#include <vector>
+#include "polyringbuffer.h"
+
+enum Type {BaseT, DerivedT};
+
+class Base {
+public:
+    static inline std::atomic<int> destructor_count {0};
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+
+    ~Base() {
+        ++destructor_count;
+    };
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+TEST_SUITE_BEGIN("PolyRingBuffer");
+TEST_CASE_TEMPLATE("FIFO order and in-place destruction", Ring,
+                   PolyRingBuffer<Base, 4, RingMode::spsc>, PolyRingBuffer<Base, 4, RingMode::mpmc>) {
+    Base::destructor_count = 0;
+    Ring ring;
+    CHECK(ring.template try_emplace<Base>(1));
+    CHECK(ring.template try_emplace<Derived>(2));
+    CHECK(ring.size() == 2);
+
+    Type type;
+    int data;
+    auto read = [&](Base& item) {
+        type = item.get_type();
+        data = item.data;
+    };
+
+    CHECK(ring.consume(read));
+    CHECK(type == BaseT);
+    CHECK(data == 1);
+    CHECK(ring.consume(read));
+    CHECK(type == DerivedT);
+    CHECK(data == 2);
+    CHECK(!ring.consume(read));
+    CHECK(Base::destructor_count == 2);
+}
+
+TEST_CASE_TEMPLATE("Full and wrap around", Ring,
+                   PolyRingBuffer<int, 4, RingMode::spsc>, PolyRingBuffer<int, 4, RingMode::mpmc>) {
+    Ring ring;
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            CHECK(ring.try_push(round * 4 + i));
+        }
+        CHECK(!ring.try_push(0));
+
+        for (int i = 0; i < 4; ++i) {
+            int value = -1;
+            CHECK(ring.consume([&](int& item) { value = item; }));
+            CHECK(value == round * 4 + i);
+        }
+    }
+}
+
+TEST_CASE("Destructor drains") {
+    Base::destructor_count = 0;
+    {
+        PolyRingBuffer<Base, 8> ring;
+        ring.try_emplace<Base>(1);
+        ring.try_emplace<Derived>(2);
+    }
+    CHECK(Base::destructor_count == 2);
+}
+
+TEST_CASE("SPSC threads") {
+    constexpr int message_count = 100000;
+    PolyRingBuffer<Base, 64> ring;
+
+    std::thread producer([&] {
+        for (int i = 0; i < message_count; ++i) {
+            if (i % 2 == 0) {
+                while (!ring.try_emplace<Base>(i)) {}
+            }
+            else {
+                while (!ring.try_emplace<Derived>(i)) {}
+            }
+        }
+    });
+
+    int expected = 0;
+    bool in_order = true;
+    while (expected < message_count) {
+        ring.consume([&](Base& item) {
+            in_order &= item.data == expected;
+            in_order &= item.get_type() == (expected % 2 == 0 ? BaseT : DerivedT);
+            ++expected;
+        });
+    }
+    producer.join();
+
+    CHECK(in_order);
+}
+
+TEST_CASE("MPMC threads") {
+    constexpr int thread_count = 3;
+    constexpr int per_thread = 20000;
+    PolyRingBuffer<Base, 64, RingMode::mpmc> ring;
+    std::atomic<int> consumed {0};
+    std::atomic<long long> sum {0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&ring, t] {
+            for (int i = 0; i < per_thread; ++i) {
+                while (!ring.try_emplace<Derived>(t * per_thread + i)) {}
+            }
+        });
+        threads.emplace_back([&] {
+            while (consumed.load() < thread_count * per_thread) {
+                ring.consume([&](Base& item) {
+                    sum += item.data;
+                    ++consumed;
+                });
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    long long total = thread_count * per_thread;
+    CHECK(consumed == total);
+    CHECK(sum == total * (total - 1) / 2);
+}
+TEST_SUITE_END();
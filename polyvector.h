@@ -1,6 +1,8 @@
 #ifndef POLYVECTOR_H
 #define POLYVECTOR_H 
 
+#include <algorithm>
+#include <compare>
 #include <cstddef>
 #include <memory>
 #include <iostream>
@@ -8,6 +10,8 @@
 #include <iterator>
 #include <cstring>
 #include <initializer_list>
+#include <source_location>
+#include <type_traits>
 
 template<typename a, typename b>
 concept same_size = sizeof(a) == sizeof(b);
@@ -15,12 +19,36 @@ concept same_size = sizeof(a) == sizeof(b);
 template<typename Derived, typename Base>
 concept emplaceable_from = same_size<Derived, Base> && std::derived_from<Derived, Base>;
 
-template<typename Base, typename Allocator = std::allocator<Base>> 
+// Dynamic type of a polymorphic element, read from the vtable pointer at the
+// front of its slot without a virtual call
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+const void* vptr_of(const Base& item) {
+    const void* vptr;
+    std::memcpy(&vptr, static_cast<const void*>(std::addressof(item)), sizeof(vptr));
+    return vptr;
+}
+
+// Stats policy that records nothing. Its hooks are empty and it takes no space,
+// so a PolyVector without stats compiles as if the hooks weren't there. See
+// PolyVectorStats in polyvector_stats.h for one that counts.
+struct NoPolyVectorStats {
+    void on_allocate(size_t) {}
+    void on_reallocate(size_t) {}
+    void on_insert(size_t) {}
+    void on_erase(size_t) {}
+    void on_resize(size_t, size_t) {}
+    void on_destroy(size_t) {}
+    void on_grow(const std::source_location&, size_t, size_t, size_t) {}
+};
+
+template<typename Base, typename Allocator = std::allocator<Base>, typename Stats = NoPolyVectorStats>
 class PolyVector {
 public:
     // Member types
     using value_type = Base;
     using allocator_type = Allocator;
+    using stats_type = Stats;
     using size_type = size_t;
     using reference = Base&;
     using pointer = Base*;
@@ -44,6 +72,10 @@ public:
                 return *mPtr;
             }
 
+            Base* operator->() const {
+                return mPtr;
+            }
+
             iterator& operator++() {
                 ++mPtr;
                 return *this;
@@ -62,6 +94,51 @@ public:
             bool operator!=(const iterator other) const {
                 return other.mPtr != mPtr;
             }
+
+            auto operator<=>(const iterator other) const {
+                return mPtr <=> other.mPtr;
+            }
+
+            iterator& operator--() {
+                --mPtr;
+                return *this;
+            }
+
+            iterator operator--(int) {
+                iterator tmp = *this;
+                --(*this);
+                return tmp;
+            }
+
+            iterator& operator+=(difference_type offset) {
+                mPtr += offset;
+                return *this;
+            }
+
+            iterator& operator-=(difference_type offset) {
+                mPtr -= offset;
+                return *this;
+            }
+
+            iterator operator+(difference_type offset) const {
+                return iterator(mPtr + offset);
+            }
+
+            friend iterator operator+(difference_type offset, const iterator it) {
+                return it + offset;
+            }
+
+            iterator operator-(difference_type offset) const {
+                return iterator(mPtr - offset);
+            }
+
+            difference_type operator-(const iterator other) const {
+                return mPtr - other.mPtr;
+            }
+
+            Base& operator[](difference_type offset) const {
+                return mPtr[offset];
+            }
             
         private:
             Base* mPtr;
@@ -96,68 +173,85 @@ public:
 
     // Capacity
     size_t size();
-    void reserve(size_t new_capacity);
+    void reserve(size_t new_capacity, std::source_location location = std::source_location::current());
     size_t capacity();
 
     // Modifiers
     void clear();
-    void insert(const iterator pos, const Base& value);
+    void insert(const iterator pos, const Base& value, std::source_location location = std::source_location::current());
     void erase_value(const Base& value);
-    void push_back(Base value);
+    void push_back(Base value, std::source_location location = std::source_location::current());
     template <typename Derived, typename... Args>
     requires emplaceable_from<Derived, Base> 
     void emplace_back(Args&&... args);
+    template <typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base> 
+    void emplace_back_at(std::source_location location, Args&&... args);
     void pop_back();
-    
+
+    // Raw relocation, for moving elements between containers bitwise
+    Base* append_uninitialized(size_t count, std::source_location location = std::source_location::current());
+    void release_elements();
+
+    // Instrumentation
+    Stats& stats() {
+        return stats_;
+    }
 
 private:
     Base* data_ {nullptr};
     size_t size_ {0};
     size_t capacity_ {0};
+    [[no_unique_address]] Stats stats_;
 
-    void trusted_reserve(size_t new_capacity);
-    void expand_if_full();
+    void trusted_reserve(size_t new_capacity, const std::source_location& location);
+    void expand_if_full(const std::source_location& location);
 };
 
 // private
 
-template<typename Base, typename Allocator> 
-void PolyVector<Base, Allocator>::trusted_reserve(size_t new_capacity) {
+template<typename Base, typename Allocator, typename Stats>
+void PolyVector<Base, Allocator, Stats>::trusted_reserve(size_t new_capacity, const std::source_location& location) {
 
     Allocator allocator;
     Base* new_data = allocator.allocate(new_capacity);
+    stats_.on_allocate(sizeof(Base) * new_capacity);
     
     if (data_ != nullptr) {
         std::memcpy(static_cast<void*>(new_data), static_cast<void*>(data_), sizeof(Base) * size_);
         allocator.deallocate(data_, capacity_);
+        stats_.on_reallocate(sizeof(Base) * size_);
+        stats_.on_grow(location, capacity_, new_capacity, sizeof(Base) * size_);
     }
     data_ = new_data;
     capacity_ = new_capacity;
+    stats_.on_resize(size_, capacity_);
 }
 
-template<typename Base, typename Allocator> 
-void PolyVector<Base, Allocator>::expand_if_full() {
+template<typename Base, typename Allocator, typename Stats>
+void PolyVector<Base, Allocator, Stats>::expand_if_full(const std::source_location& location) {
     if (size_ == capacity_) {
-        trusted_reserve(capacity_ == 0 ? 1 : capacity_ * 2);
+        trusted_reserve(capacity_ == 0 ? 1 : capacity_ * 2, location);
     }
 }
 
 // Member functions
-template<typename Base, typename Allocator> 
-PolyVector<Base, Allocator>::PolyVector(std::initializer_list<Base> init) {
+template<typename Base, typename Allocator, typename Stats>
+PolyVector<Base, Allocator, Stats>::PolyVector(std::initializer_list<Base> init) {
     for (Base item : init) {
         push_back(item);
     }
 }
 
-template<typename Base, typename Allocator> 
-PolyVector<Base, Allocator>::~PolyVector() {
+template<typename Base, typename Allocator, typename Stats>
+PolyVector<Base, Allocator, Stats>::~PolyVector() {
     if (data_ != nullptr) {
         Allocator allocator;
         for (size_t index = 0; index < size_; ++index) {
             data_[index].~Base();
         } 
         allocator.deallocate(data_, capacity_);
+        stats_.on_destroy(size_);
     }
     data_ = nullptr;
     size_ = 0;
@@ -166,59 +260,61 @@ PolyVector<Base, Allocator>::~PolyVector() {
 
 // Element access
 
-template<typename Base, typename Allocator> 
-Base& PolyVector<Base, Allocator>::operator[](size_t index) {
+template<typename Base, typename Allocator, typename Stats>
+Base& PolyVector<Base, Allocator, Stats>::operator[](size_t index) {
     return data_[index];
 }
 
-template<typename Base, typename Allocator> 
-Base& PolyVector<Base, Allocator>::front() {
+template<typename Base, typename Allocator, typename Stats>
+Base& PolyVector<Base, Allocator, Stats>::front() {
     return data_[0];
 }
 
-template<typename Base, typename Allocator> 
-Base& PolyVector<Base, Allocator>::back() {
+template<typename Base, typename Allocator, typename Stats>
+Base& PolyVector<Base, Allocator, Stats>::back() {
     return data_[size_ - 1];
 }
 
-template<typename Base, typename Allocator> 
-Base* PolyVector<Base, Allocator>::data() {
+template<typename Base, typename Allocator, typename Stats>
+Base* PolyVector<Base, Allocator, Stats>::data() {
     return data_;
 }
 
 // Capacity
 
-template<typename Base, typename Allocator> 
-size_t PolyVector<Base, Allocator>::size() {
+template<typename Base, typename Allocator, typename Stats>
+size_t PolyVector<Base, Allocator, Stats>::size() {
     return size_;
 }
 
-template<typename Base, typename Allocator> 
-void PolyVector<Base, Allocator>::reserve(size_t new_capacity) {
+template<typename Base, typename Allocator, typename Stats>
+void PolyVector<Base, Allocator, Stats>::reserve(size_t new_capacity, std::source_location location) {
     if (new_capacity > capacity_) {
-        trusted_reserve(new_capacity);
+        trusted_reserve(new_capacity, location);
     }
 }
 
-template<typename Base, typename Allocator> 
-size_t PolyVector<Base, Allocator>::capacity() {
+template<typename Base, typename Allocator, typename Stats>
+size_t PolyVector<Base, Allocator, Stats>::capacity() {
     return capacity_;
 }
 
 // Modifiers
 
-template<typename Base, typename Allocator> 
-void PolyVector<Base, Allocator>::clear() {
-    for (size_t index = 0; index < capacity_; ++index) {
+template<typename Base, typename Allocator, typename Stats>
+void PolyVector<Base, Allocator, Stats>::clear() {
+    for (size_t index = 0; index < size_; ++index) {
         data_[index].~Base();
     }
+    stats_.on_destroy(size_);
     size_ = 0;
 }
 
-template<typename Base, typename Allocator> 
-void PolyVector<Base, Allocator>::insert(const iterator pos, const Base& value) {
+template<typename Base, typename Allocator, typename Stats>
+void PolyVector<Base, Allocator, Stats>::insert(const iterator pos, const Base& value, std::source_location location) {
     if (data_ == nullptr) {
-        push_back(value);
+        stats_.on_insert(0);
+        push_back(value, location);
         return;
     }
 
@@ -226,6 +322,7 @@ void PolyVector<Base, Allocator>::insert(const iterator pos, const Base& value)
         size_t new_capacity = capacity_ * 2;
         Allocator allocator;
         Base* new_data = allocator.allocate(new_capacity);
+        stats_.on_allocate(sizeof(Base) * new_capacity);
         
         size_t insert_offset = std::addressof(*pos) - data_;
 
@@ -235,6 +332,11 @@ void PolyVector<Base, Allocator>::insert(const iterator pos, const Base& value)
                     sizeof(Base) * (size_ - insert_offset));
         new (new_data + insert_offset) Base{value};
         allocator.deallocate(data_, capacity_);
+        // The copy before the insertion point counts as relocation, the
+        // shifted tail as the insert's move
+        stats_.on_reallocate(sizeof(Base) * insert_offset);
+        stats_.on_insert(sizeof(Base) * (size_ - insert_offset));
+        stats_.on_grow(location, capacity_, new_capacity, sizeof(Base) * size_);
         data_ = new_data;
         capacity_ = new_capacity;
     }
@@ -244,12 +346,14 @@ void PolyVector<Base, Allocator>::insert(const iterator pos, const Base& value)
                     static_cast<void*>(data_ + insert_offset),
                     sizeof(Base) * (size_ - insert_offset));
         new (data_ + insert_offset) Base{value};
+        stats_.on_insert(sizeof(Base) * (size_ - insert_offset));
     }
     ++size_;
+    stats_.on_resize(size_, capacity_);
 }
 
-template<typename Base, typename Allocator> 
-void PolyVector<Base, Allocator>::erase_value(const Base& value) {
+template<typename Base, typename Allocator, typename Stats>
+void PolyVector<Base, Allocator, Stats>::erase_value(const Base& value) {
     size_t first;
     for (first = 0; first < size_; ++first) {
         if (data_[first] == value) {
@@ -263,43 +367,89 @@ void PolyVector<Base, Allocator>::erase_value(const Base& value) {
     }
 
     size_t i;
+    size_t moved = 0;
     for(i = first + 1; i < size_; ++i) {
         if (data_[i] != value) {
             std::memcpy(static_cast<void*>(data_ + first),
                         static_cast<void*>(data_ + i),
                         sizeof(Base));
             ++first;
+            ++moved;
         }
         else {
             data_[i].~Base();
         }
     }
+    stats_.on_erase(sizeof(Base) * moved);
+    stats_.on_destroy(i - first);
     size_ -= i - first; 
 }
 
-template<typename Base, typename Allocator> 
-void PolyVector<Base, Allocator>::push_back(Base value) {
-    expand_if_full();
+template<typename Base, typename Allocator, typename Stats>
+void PolyVector<Base, Allocator, Stats>::push_back(Base value, std::source_location location) {
+    expand_if_full(location);
     new (data_ + size_) Base{value};
     ++size_;
+    stats_.on_resize(size_, capacity_);
 }
 
 
-template<typename Base, typename Allocator> 
+// An argument pack can't be followed by a defaulted source_location, so every
+// growth through emplace_back is traced to this one line, and
+// PolyVectorGrowthTrace::top() can't tell its callers apart. Where that
+// matters, call emplace_back_at, or POLYVECTOR_EMPLACE_BACK which passes the
+// caller's location.
+template<typename Base, typename Allocator, typename Stats>
 template<typename Derived, typename... Args>
 requires emplaceable_from<Derived, Base>
-void PolyVector<Base, Allocator>::emplace_back(Args&&... args) {
-    expand_if_full();
+void PolyVector<Base, Allocator, Stats>::emplace_back(Args&&... args) {
+    emplace_back_at<Derived>(std::source_location::current(), std::forward<Args>(args)...);
+}
+
+// emplace_back_at<Derived> with the location of the line it is written on
+#define POLYVECTOR_EMPLACE_BACK(vec, Derived, ...) \
+    (vec).template emplace_back_at<Derived>(std::source_location::current() __VA_OPT__(,) __VA_ARGS__)
+
+template<typename Base, typename Allocator, typename Stats>
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base>
+void PolyVector<Base, Allocator, Stats>::emplace_back_at(std::source_location location, Args&&... args) {
+    expand_if_full(location);
     new (data_ + size_) Derived(std::forward<Args>(args)...);
     ++size_;
+    stats_.on_resize(size_, capacity_);
 }
 
-template<typename Base, typename Allocator> 
-void PolyVector<Base, Allocator>::pop_back() {
+template<typename Base, typename Allocator, typename Stats>
+void PolyVector<Base, Allocator, Stats>::pop_back() {
     if (size_ > 0) {
         data_[size_ - 1].~Base();
         size_--;
+        stats_.on_destroy(1);
+    }
+}
+
+// Raw relocation
+
+// Grows size by count and returns the first new slot. The caller must fill
+// every new slot, by construction or bitwise relocation, before the vector is
+// used again.
+template<typename Base, typename Allocator, typename Stats>
+Base* PolyVector<Base, Allocator, Stats>::append_uninitialized(size_t count, std::source_location location) {
+    if (size_ + count > capacity_) {
+        trusted_reserve(std::max(size_ + count, capacity_ * 2), location);
     }
+    Base* first = data_ + size_;
+    size_ += count;
+    stats_.on_resize(size_, capacity_);
+    return first;
+}
+
+// Empties the vector without running destructors, for when the elements have
+// been relocated elsewhere. Capacity is kept.
+template<typename Base, typename Allocator, typename Stats>
+void PolyVector<Base, Allocator, Stats>::release_elements() {
+    size_ = 0;
 }
 
 #endif
@@ -0,0 +1,490 @@
+#ifndef POLYVECTOR_ALGORITHM_H
+#define POLYVECTOR_ALGORITHM_H
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "polyvector.h"
+
+// Algorithms that permute PolyVector elements by relocating whole slots bitwise,
+// the way trusted_reserve does. No element is copied, moved or called virtually
+// while it is relocated, so they work for non-movable polymorphic types.
+
+// Scratch storage for one element in transit
+template<typename Base>
+struct SlotBuffer {
+    alignas(Base) unsigned char bytes[sizeof(Base)];
+};
+
+// Moves the element at sources[i] to position i, for every i. Each permutation
+// cycle is followed from a hole, so every element is relocated exactly once.
+// sources is left as the identity.
+template<typename Base, typename Allocator, typename Stats>
+void relocate_permutation(PolyVector<Base, Allocator, Stats>& vec, std::vector<size_t>& sources) {
+    Base* data = vec.data();
+    SlotBuffer<Base> held;
+    for (size_t start = 0; start < sources.size(); ++start) {
+        if (sources[start] == start) {
+            continue;
+        }
+
+        std::memcpy(held.bytes, static_cast<void*>(data + start), sizeof(Base));
+        size_t hole = start;
+        while (true) {
+            size_t from = sources[hole];
+            sources[hole] = hole;
+            if (from == start) {
+                std::memcpy(static_cast<void*>(data + hole), held.bytes, sizeof(Base));
+                break;
+            }
+            std::memcpy(static_cast<void*>(data + hole), static_cast<void*>(data + from), sizeof(Base));
+            hole = from;
+        }
+    }
+}
+
+template<typename Base>
+void swap_slots(Base* first, Base* second) {
+    SlotBuffer<Base> held;
+    std::memcpy(held.bytes, static_cast<void*>(first), sizeof(Base));
+    std::memcpy(static_cast<void*>(first), static_cast<void*>(second), sizeof(Base));
+    std::memcpy(static_cast<void*>(second), held.bytes, sizeof(Base));
+}
+
+// Gives each distinct dynamic type a dense bucket number, in order of first
+// appearance, and counts the elements in each.
+template<typename Base, typename Allocator, typename Stats>
+std::vector<uint32_t> type_buckets(PolyVector<Base, Allocator, Stats>& vec, std::vector<size_t>& counts) {
+    std::vector<uint32_t> buckets(vec.size());
+    std::unordered_map<const void*, uint32_t> bucket_of;
+    const void* last_vptr = nullptr;
+    uint32_t last_bucket = 0;
+
+    for (size_t index = 0; index < vec.size(); ++index) {
+        const void* vptr = vptr_of(vec[index]);
+        if (vptr != last_vptr) {
+            auto [entry, inserted] = bucket_of.try_emplace(vptr, static_cast<uint32_t>(counts.size()));
+            if (inserted) {
+                counts.push_back(0);
+            }
+            last_vptr = vptr;
+            last_bucket = entry->second;
+        }
+        buckets[index] = last_bucket;
+        ++counts[last_bucket];
+    }
+    return buckets;
+}
+
+// Groups elements by dynamic type, types in order of first appearance, so a
+// traversal calling a virtual function sees long runs of one target.
+// American flag sort: one counting pass, then each misplaced element is carried
+// straight to its bucket. Relative order within a type is not kept.
+template<typename Base, typename Allocator, typename Stats>
+requires std::is_polymorphic_v<Base>
+void sort_by_type(PolyVector<Base, Allocator, Stats>& vec) {
+    std::vector<size_t> counts;
+    std::vector<uint32_t> buckets = type_buckets(vec, counts);
+    if (counts.size() <= 1) {
+        return;
+    }
+
+    std::vector<size_t> next(counts.size());
+    std::vector<size_t> end(counts.size());
+    size_t offset = 0;
+    for (size_t bucket = 0; bucket < counts.size(); ++bucket) {
+        next[bucket] = offset;
+        offset += counts[bucket];
+        end[bucket] = offset;
+    }
+
+    Base* data = vec.data();
+    SlotBuffer<Base> first;
+    SlotBuffer<Base> second;
+    for (uint32_t bucket = 0; bucket < counts.size(); ++bucket) {
+        while (next[bucket] < end[bucket]) {
+            size_t position = next[bucket];
+            if (buckets[position] == bucket) {
+                ++next[bucket];
+                continue;
+            }
+
+            // Carry the misplaced element to its bucket and pick up whatever it
+            // displaces, until the carried element belongs here.
+            unsigned char* carry = first.bytes;
+            unsigned char* spare = second.bytes;
+            std::memcpy(carry, static_cast<void*>(data + position), sizeof(Base));
+            uint32_t carry_bucket = buckets[position];
+            while (carry_bucket != bucket) {
+                size_t target = next[carry_bucket]++;
+                while (buckets[target] == carry_bucket) {
+                    target = next[carry_bucket]++;
+                }
+                std::memcpy(spare, static_cast<void*>(data + target), sizeof(Base));
+                std::memcpy(static_cast<void*>(data + target), carry, sizeof(Base));
+                std::swap(carry, spare);
+                std::swap(carry_bucket, buckets[target]);
+            }
+            std::memcpy(static_cast<void*>(data + position), carry, sizeof(Base));
+            buckets[position] = bucket;
+            ++next[bucket];
+        }
+    }
+}
+
+// As sort_by_type, but keeps the relative order of elements of the same type.
+// Counting sort into a source index per position, then one relocation pass.
+template<typename Base, typename Allocator, typename Stats>
+requires std::is_polymorphic_v<Base>
+void stable_sort_by_type(PolyVector<Base, Allocator, Stats>& vec) {
+    std::vector<size_t> counts;
+    std::vector<uint32_t> buckets = type_buckets(vec, counts);
+    if (counts.size() <= 1) {
+        return;
+    }
+
+    std::vector<size_t> next(counts.size());
+    size_t offset = 0;
+    for (size_t bucket = 0; bucket < counts.size(); ++bucket) {
+        next[bucket] = offset;
+        offset += counts[bucket];
+    }
+
+    std::vector<size_t> sources(vec.size());
+    for (size_t index = 0; index < buckets.size(); ++index) {
+        sources[next[buckets[index]]++] = index;
+    }
+    relocate_permutation(vec, sources);
+}
+
+// Comparison algorithms. The std algorithm runs over an array of element
+// pointers, calling comp through them, and the order it leaves is then applied
+// with relocate_permutation. The poly_ prefix keeps them apart from the std
+// algorithms they mirror, which ADL or a using-directive would otherwise pull
+// into the same overload set.
+
+template<typename Base, typename Allocator, typename Stats>
+std::vector<Base*> element_pointers(PolyVector<Base, Allocator, Stats>& vec) {
+    std::vector<Base*> pointers(vec.size());
+    for (size_t index = 0; index < pointers.size(); ++index) {
+        pointers[index] = vec.data() + index;
+    }
+    return pointers;
+}
+
+template<typename Base, typename Allocator, typename Stats>
+void relocate_to_order(PolyVector<Base, Allocator, Stats>& vec, const std::vector<Base*>& order) {
+    std::vector<size_t> sources(order.size());
+    for (size_t index = 0; index < order.size(); ++index) {
+        sources[index] = order[index] - vec.data();
+    }
+    relocate_permutation(vec, sources);
+}
+
+template<typename Base, typename Allocator, typename Stats, typename Compare = std::less<>>
+void poly_sort(PolyVector<Base, Allocator, Stats>& vec, Compare comp = Compare{}) {
+    std::vector<Base*> order = element_pointers(vec);
+    std::sort(order.begin(), order.end(), [&comp](Base* first, Base* second) {
+        return comp(*first, *second);
+    });
+    relocate_to_order(vec, order);
+}
+
+template<typename Base, typename Allocator, typename Stats, typename Compare = std::less<>>
+void poly_stable_sort(PolyVector<Base, Allocator, Stats>& vec, Compare comp = Compare{}) {
+    std::vector<Base*> order = element_pointers(vec);
+    std::stable_sort(order.begin(), order.end(), [&comp](Base* first, Base* second) {
+        return comp(*first, *second);
+    });
+    relocate_to_order(vec, order);
+}
+
+template<typename Base, typename Allocator, typename Stats, typename Compare = std::less<>>
+void poly_partial_sort(PolyVector<Base, Allocator, Stats>& vec, typename PolyVector<Base, Allocator, Stats>::iterator middle,
+                  Compare comp = Compare{}) {
+    std::vector<Base*> order = element_pointers(vec);
+    std::partial_sort(order.begin(), order.begin() + (middle - vec.begin()), order.end(),
+                      [&comp](Base* first, Base* second) {
+        return comp(*first, *second);
+    });
+    relocate_to_order(vec, order);
+}
+
+template<typename Base, typename Allocator, typename Stats, typename Compare = std::less<>>
+void poly_nth_element(PolyVector<Base, Allocator, Stats>& vec, typename PolyVector<Base, Allocator, Stats>::iterator nth,
+                 Compare comp = Compare{}) {
+    std::vector<Base*> order = element_pointers(vec);
+    std::nth_element(order.begin(), order.begin() + (nth - vec.begin()), order.end(),
+                     [&comp](Base* first, Base* second) {
+        return comp(*first, *second);
+    });
+    relocate_to_order(vec, order);
+}
+
+// Hoare partition, swapping slots in place. Returns the first element for
+// which pred is false.
+template<typename Base, typename Allocator, typename Stats, typename Predicate>
+typename PolyVector<Base, Allocator, Stats>::iterator poly_partition(PolyVector<Base, Allocator, Stats>& vec, Predicate pred) {
+    Base* data = vec.data();
+    size_t first = 0;
+    size_t last = vec.size();
+    while (true) {
+        while (first != last && pred(data[first])) {
+            ++first;
+        }
+        if (first == last) {
+            break;
+        }
+        --last;
+        while (first != last && !pred(data[last])) {
+            --last;
+        }
+        if (first == last) {
+            break;
+        }
+        swap_slots(data + first, data + last);
+        ++first;
+    }
+    return vec.begin() + first;
+}
+
+// Calls pred once per element, then relocates the matching elements ahead of
+// the rest, keeping relative order in both groups.
+template<typename Base, typename Allocator, typename Stats, typename Predicate>
+typename PolyVector<Base, Allocator, Stats>::iterator poly_stable_partition(PolyVector<Base, Allocator, Stats>& vec, Predicate pred) {
+    std::vector<size_t> sources;
+    std::vector<size_t> rejected;
+    sources.reserve(vec.size());
+    for (size_t index = 0; index < vec.size(); ++index) {
+        if (pred(vec[index])) {
+            sources.push_back(index);
+        }
+        else {
+            rejected.push_back(index);
+        }
+    }
+    size_t matched = sources.size();
+    sources.insert(sources.end(), rejected.begin(), rejected.end());
+    relocate_permutation(vec, sources);
+    return vec.begin() + matched;
+}
+
+// Makes middle the first element. Each of the gcd(size, shift) cycles is
+// followed from a hole, so every element is relocated once. Returns the new
+// position of the old first element.
+template<typename Base, typename Allocator, typename Stats>
+typename PolyVector<Base, Allocator, Stats>::iterator poly_rotate(PolyVector<Base, Allocator, Stats>& vec,
+                                                      typename PolyVector<Base, Allocator, Stats>::iterator middle) {
+    size_t size = vec.size();
+    size_t shift = middle - vec.begin();
+    if (shift == 0 || shift == size) {
+        return vec.begin() + (size - shift);
+    }
+
+    Base* data = vec.data();
+    SlotBuffer<Base> held;
+    size_t cycles = std::gcd(size, shift);
+    for (size_t start = 0; start < cycles; ++start) {
+        std::memcpy(held.bytes, static_cast<void*>(data + start), sizeof(Base));
+        size_t hole = start;
+        while (true) {
+            size_t from = hole + shift < size ? hole + shift : hole + shift - size;
+            if (from == start) {
+                break;
+            }
+            std::memcpy(static_cast<void*>(data + hole), static_cast<void*>(data + from), sizeof(Base));
+            hole = from;
+        }
+        std::memcpy(static_cast<void*>(data + hole), held.bytes, sizeof(Base));
+    }
+    return vec.begin() + (size - shift);
+}
+
+template<typename Base, typename Allocator, typename Stats>
+void poly_reverse(PolyVector<Base, Allocator, Stats>& vec) {
+    Base* data = vec.data();
+    size_t size = vec.size();
+    for (size_t index = 0; index < size / 2; ++index) {
+        swap_slots(data + index, data + size - 1 - index);
+    }
+}
+
+// Parallel sort by key
+
+constexpr size_t parallel_sort_min_per_thread = 1 << 14;
+
+// Splits [0, count) into one contiguous range per thread and runs
+// f(thread, begin, end) on each, the first on the calling thread.
+template<typename F>
+void parallel_ranges(size_t count, size_t thread_count, F&& f) {
+    auto range_begin = [&](size_t thread) {
+        return count * thread / thread_count;
+    };
+    std::vector<std::thread> workers;
+    for (size_t thread = 1; thread < thread_count; ++thread) {
+        workers.emplace_back([&f, thread, begin = range_begin(thread), end = range_begin(thread + 1)] {
+            f(thread, begin, end);
+        });
+    }
+    f(0, range_begin(0), range_begin(1));
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+template<typename Key>
+struct KeyedIndex {
+    Key key;
+    size_t index;
+};
+
+// Maps an arithmetic key to unsigned bits with the same ordering
+template<typename Key>
+uint64_t radix_bits(Key key) {
+    if constexpr (std::is_floating_point_v<Key>) {
+        uint64_t bits = std::bit_cast<uint64_t>(static_cast<double>(key));
+        return bits >> 63 ? ~bits : bits | (uint64_t{1} << 63);
+    }
+    else if constexpr (std::is_signed_v<Key>) {
+        return static_cast<uint64_t>(static_cast<int64_t>(key)) ^ (uint64_t{1} << 63);
+    }
+    else {
+        return static_cast<uint64_t>(key);
+    }
+}
+
+// Stable LSD radix sort, a byte per pass. Each thread histograms its own range,
+// the histograms are combined into per-thread scatter offsets, and each thread
+// scatters its range. Passes where every key has the same byte are skipped.
+inline void parallel_radix_sort(std::vector<KeyedIndex<uint64_t>>& items, size_t thread_count) {
+    std::vector<KeyedIndex<uint64_t>> scratch(items.size());
+    std::vector<std::array<size_t, 256>> counts(thread_count);
+
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        parallel_ranges(items.size(), thread_count, [&](size_t thread, size_t begin, size_t end) {
+            counts[thread].fill(0);
+            for (size_t index = begin; index < end; ++index) {
+                ++counts[thread][(items[index].key >> shift) & 0xff];
+            }
+        });
+
+        bool uniform = false;
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; ++digit) {
+            size_t digit_total = 0;
+            for (size_t thread = 0; thread < thread_count; ++thread) {
+                size_t count = counts[thread][digit];
+                counts[thread][digit] = offset;
+                offset += count;
+                digit_total += count;
+            }
+            uniform |= digit_total == items.size();
+        }
+        if (uniform) {
+            continue;
+        }
+
+        parallel_ranges(items.size(), thread_count, [&](size_t thread, size_t begin, size_t end) {
+            for (size_t index = begin; index < end; ++index) {
+                scratch[counts[thread][(items[index].key >> shift) & 0xff]++] = items[index];
+            }
+        });
+        items.swap(scratch);
+    }
+}
+
+// Sorts each thread's range, then merges neighbouring runs pairwise in
+// parallel rounds. Ties are broken by index, which keeps the sort stable.
+template<typename Key>
+void parallel_merge_sort(std::vector<KeyedIndex<Key>>& items, size_t thread_count) {
+    auto less = [](const KeyedIndex<Key>& first, const KeyedIndex<Key>& second) {
+        return first.key < second.key || (!(second.key < first.key) && first.index < second.index);
+    };
+
+    std::vector<size_t> bounds(thread_count + 1);
+    for (size_t thread = 0; thread <= thread_count; ++thread) {
+        bounds[thread] = items.size() * thread / thread_count;
+    }
+    parallel_ranges(items.size(), thread_count, [&](size_t, size_t begin, size_t end) {
+        std::sort(items.begin() + begin, items.begin() + end, less);
+    });
+
+    std::vector<KeyedIndex<Key>> scratch(items.size());
+    while (bounds.size() > 2) {
+        size_t pairs = (bounds.size() - 1) / 2;
+        std::vector<std::thread> mergers;
+        for (size_t pair = 0; pair < pairs; ++pair) {
+            size_t begin = bounds[2 * pair];
+            size_t middle = bounds[2 * pair + 1];
+            size_t end = bounds[2 * pair + 2];
+            mergers.emplace_back([&items, &scratch, &less, begin, middle, end] {
+                std::merge(items.begin() + begin, items.begin() + middle, items.begin() + middle,
+                           items.begin() + end, scratch.begin() + begin, less);
+            });
+        }
+        std::vector<size_t> merged_bounds;
+        for (size_t bound = 0; bound < bounds.size(); bound += 2) {
+            merged_bounds.push_back(bounds[bound]);
+        }
+        if ((bounds.size() - 1) % 2 == 1) {
+            size_t begin = bounds[bounds.size() - 2];
+            std::copy(items.begin() + begin, items.end(), scratch.begin() + begin);
+            merged_bounds.push_back(bounds.back());
+        }
+        for (std::thread& merger : mergers) {
+            merger.join();
+        }
+        items.swap(scratch);
+        bounds.swap(merged_bounds);
+    }
+}
+
+// Stable sort by key_fn(Base&), which is called once per element, in parallel.
+// Integral and floating point keys are radix sorted; other keys, which need
+// operator<, are merge sorted. The order is then applied with
+// relocate_permutation, moving each element once. thread_count 0 uses every
+// hardware thread, scaled down for small vectors.
+template<typename Base, typename Allocator, typename Stats, typename KeyFn>
+void parallel_sort(PolyVector<Base, Allocator, Stats>& vec, KeyFn key_fn, size_t thread_count = 0) {
+    using Key = std::decay_t<std::invoke_result_t<KeyFn&, Base&>>;
+    size_t size = vec.size();
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    thread_count = std::clamp<size_t>(size / parallel_sort_min_per_thread, 1, thread_count);
+
+    std::vector<size_t> sources(size);
+    if constexpr (std::is_arithmetic_v<Key>) {
+        std::vector<KeyedIndex<uint64_t>> items(size);
+        parallel_ranges(size, thread_count, [&](size_t, size_t begin, size_t end) {
+            for (size_t index = begin; index < end; ++index) {
+                items[index] = {radix_bits(key_fn(vec[index])), index};
+            }
+        });
+        parallel_radix_sort(items, thread_count);
+        for (size_t index = 0; index < size; ++index) {
+            sources[index] = items[index].index;
+        }
+    }
+    else {
+        std::vector<KeyedIndex<Key>> items(size);
+        parallel_ranges(size, thread_count, [&](size_t, size_t begin, size_t end) {
+            for (size_t index = begin; index < end; ++index) {
+                items[index] = {key_fn(vec[index]), index};
+            }
+        });
+        parallel_merge_sort(items, thread_count);
+        for (size_t index = 0; index < size; ++index) {
+            sources[index] = items[index].index;
+        }
+    }
+    relocate_permutation(vec, sources);
+}
+
+#endif
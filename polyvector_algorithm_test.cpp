@@ -0,0 +1,397 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "polyvector_algorithm.h"
+
+enum Type {BaseT, DerivedT, OtherT};
+
+struct Counter {
+    int constructor_count {0};
+    int destructor_count {0};
+};
+
+class Base {
+public:
+    Counter *counter;
+    int data;
+
+    Base(Counter* counter_in, int data_in) : counter{counter_in}, data{data_in} {
+        ++(counter->constructor_count);
+    };
+
+    ~Base() {
+        ++(counter->destructor_count);
+    };
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(Counter* counter_in, int data_in) : Base(counter_in, data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+class Other : public Base {
+public:
+    Other(Counter* counter_in, int data_in) : Base(counter_in, data_in) {};
+    virtual Type get_type() {
+        return OtherT;
+    }
+};
+
+// Element i gets data i and a type from a fixed pseudo-random pattern
+static void fill_mixed(PolyVector<Base>& vec, Counter* counter, int count) {
+    for (int i = 0; i < count; ++i) {
+        switch ((i * 7 + i / 3) % 3) {
+            case 0: vec.emplace_back<Base>(counter, i); break;
+            case 1: vec.emplace_back<Derived>(counter, i); break;
+            default: vec.emplace_back<Other>(counter, i); break;
+        }
+    }
+}
+
+static Type expected_type(int data) {
+    return static_cast<Type>((data * 7 + data / 3) % 3);
+}
+
+static std::vector<Type> type_runs(PolyVector<Base>& vec) {
+    std::vector<Type> runs;
+    for (Base& item : vec) {
+        if (runs.empty() || runs.back() != item.get_type()) {
+            runs.push_back(item.get_type());
+        }
+    }
+    return runs;
+}
+
+static bool elements_intact(PolyVector<Base>& vec, int count) {
+    std::vector<bool> seen(count, false);
+    for (Base& item : vec) {
+        if (item.get_type() != expected_type(item.data) || seen[item.data]) {
+            return false;
+        }
+        seen[item.data] = true;
+    }
+    return std::find(seen.begin(), seen.end(), false) == seen.end();
+}
+
+TEST_SUITE_BEGIN("Type sort");
+TEST_CASE("sort_by_type groups types") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_mixed(vec, &counter, 1000);
+
+    sort_by_type(vec);
+
+    CHECK(type_runs(vec) == std::vector<Type>{BaseT, DerivedT, OtherT});
+    CHECK(elements_intact(vec, 1000));
+    CHECK(counter.constructor_count == 1000);
+    CHECK(counter.destructor_count == 0);
+}
+
+TEST_CASE("stable_sort_by_type keeps order within a type") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_mixed(vec, &counter, 1000);
+
+    stable_sort_by_type(vec);
+
+    CHECK(type_runs(vec) == std::vector<Type>{BaseT, DerivedT, OtherT});
+    CHECK(elements_intact(vec, 1000));
+    bool ascending = true;
+    for (size_t index = 1; index < vec.size(); ++index) {
+        if (vec[index].get_type() == vec[index - 1].get_type()) {
+            ascending &= vec[index].data > vec[index - 1].data;
+        }
+    }
+    CHECK(ascending);
+    CHECK(counter.destructor_count == 0);
+}
+
+TEST_CASE("Type sort of trivial inputs") {
+    Counter counter;
+    PolyVector<Base> empty;
+    sort_by_type(empty);
+    stable_sort_by_type(empty);
+    CHECK(empty.size() == 0);
+
+    PolyVector<Base> single_type;
+    single_type.emplace_back<Derived>(&counter, 1);
+    single_type.emplace_back<Derived>(&counter, 0);
+    sort_by_type(single_type);
+    CHECK(single_type[0].data == 1);
+    CHECK(single_type[1].data == 0);
+}
+
+TEST_CASE("relocate_permutation") {
+    Counter counter;
+    PolyVector<Base> vec;
+    for (int i = 0; i < 5; ++i) {
+        vec.emplace_back<Derived>(&counter, i);
+    }
+    std::vector<size_t> sources{3, 0, 4, 1, 2};
+
+    relocate_permutation(vec, sources);
+
+    CHECK(vec[0].data == 3);
+    CHECK(vec[1].data == 0);
+    CHECK(vec[2].data == 4);
+    CHECK(vec[3].data == 1);
+    CHECK(vec[4].data == 2);
+    CHECK(sources == std::vector<size_t>{0, 1, 2, 3, 4});
+}
+TEST_SUITE_END();
+
+static std::vector<int> data_of(PolyVector<Base>& vec) {
+    std::vector<int> values;
+    for (Base& item : vec) {
+        values.push_back(item.data);
+    }
+    return values;
+}
+
+static void fill_values(PolyVector<Base>& vec, Counter* counter, std::vector<int> values) {
+    for (size_t index = 0; index < values.size(); ++index) {
+        if (index % 2 == 0) {
+            vec.emplace_back<Base>(counter, values[index]);
+        }
+        else {
+            vec.emplace_back<Derived>(counter, values[index]);
+        }
+    }
+}
+
+static bool by_data(Base& first, Base& second) {
+    return first.data < second.data;
+}
+
+TEST_SUITE_BEGIN("Relocation algorithms");
+TEST_CASE("poly_sort") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_values(vec, &counter, {5, 3, 9, 1, 7, 2});
+
+    poly_sort(vec, by_data);
+
+    CHECK(data_of(vec) == std::vector<int>{1, 2, 3, 5, 7, 9});
+    CHECK(vec[0].get_type() == DerivedT);
+    CHECK(vec[3].get_type() == BaseT);
+    CHECK(counter.destructor_count == 0);
+}
+
+TEST_CASE("poly_sort with default comparison") {
+    PolyVector<int> vec{4, 1, 3, 2};
+    poly_sort(vec);
+
+    CHECK(vec[0] == 1);
+    CHECK(vec[3] == 4);
+}
+
+TEST_CASE("poly_stable_sort") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_values(vec, &counter, {10, 21, 12, 23, 14, 25});
+
+    poly_stable_sort(vec, [](Base& first, Base& second) { return first.data / 10 < second.data / 10; });
+
+    CHECK(data_of(vec) == std::vector<int>{10, 12, 14, 21, 23, 25});
+}
+
+TEST_CASE("poly_partial_sort") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_values(vec, &counter, {5, 3, 9, 1, 7, 2});
+
+    poly_partial_sort(vec, vec.begin() + 3, by_data);
+
+    std::vector<int> values = data_of(vec);
+    CHECK(std::vector<int>(values.begin(), values.begin() + 3) == std::vector<int>{1, 2, 3});
+    std::sort(values.begin() + 3, values.end());
+    CHECK(std::vector<int>(values.begin() + 3, values.end()) == std::vector<int>{5, 7, 9});
+}
+
+TEST_CASE("poly_nth_element") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_values(vec, &counter, {5, 3, 9, 1, 7, 2});
+
+    poly_nth_element(vec, vec.begin() + 2, by_data);
+
+    CHECK(vec[2].data == 3);
+    for (size_t index = 0; index < 2; ++index) {
+        CHECK(vec[index].data < 3);
+    }
+    for (size_t index = 3; index < vec.size(); ++index) {
+        CHECK(vec[index].data > 3);
+    }
+}
+
+TEST_CASE("poly_partition") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_values(vec, &counter, {1, 2, 3, 4, 5, 6, 7});
+
+    auto is_even = [](Base& item) { return item.data % 2 == 0; };
+    auto middle = poly_partition(vec, is_even);
+
+    CHECK(middle - vec.begin() == 3);
+    for (auto it = vec.begin(); it != middle; ++it) {
+        CHECK(is_even(*it));
+    }
+    for (auto it = middle; it != vec.end(); ++it) {
+        CHECK(!is_even(*it));
+    }
+    CHECK(counter.destructor_count == 0);
+}
+
+TEST_CASE("poly_stable_partition") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_values(vec, &counter, {1, 2, 3, 4, 5, 6, 7});
+
+    auto middle = poly_stable_partition(vec, [](Base& item) { return item.data % 2 == 0; });
+
+    CHECK(middle - vec.begin() == 3);
+    CHECK(data_of(vec) == std::vector<int>{2, 4, 6, 1, 3, 5, 7});
+    CHECK(vec[0].get_type() == DerivedT);
+    CHECK(vec[3].get_type() == BaseT);
+}
+
+TEST_CASE("poly_rotate") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_values(vec, &counter, {0, 1, 2, 3, 4, 5});
+
+    auto old_first = poly_rotate(vec, vec.begin() + 4);
+
+    CHECK(data_of(vec) == std::vector<int>{4, 5, 0, 1, 2, 3});
+    CHECK(old_first->data == 0);
+    CHECK(poly_rotate(vec, vec.begin()) == vec.end());
+    CHECK(data_of(vec) == std::vector<int>{4, 5, 0, 1, 2, 3});
+}
+
+TEST_CASE("poly_reverse") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_values(vec, &counter, {0, 1, 2, 3, 4});
+
+    poly_reverse(vec);
+
+    CHECK(data_of(vec) == std::vector<int>{4, 3, 2, 1, 0});
+    CHECK(vec[0].get_type() == BaseT);
+    CHECK(vec[1].get_type() == DerivedT);
+    CHECK(counter.destructor_count == 0);
+}
+TEST_SUITE_END();
+
+// Element i gets a pseudo-random data value and alternates type
+static void fill_random(PolyVector<Base>& vec, Counter* counter, int count) {
+    std::mt19937 random(7);
+    for (int i = 0; i < count; ++i) {
+        int data = static_cast<int>(random() % 200001) - 100000;
+        if (i % 2 == 0) {
+            vec.emplace_back<Base>(counter, data);
+        }
+        else {
+            vec.emplace_back<Derived>(counter, data);
+        }
+    }
+}
+
+TEST_SUITE_BEGIN("Parallel sort");
+TEST_CASE("parallel_sort integer key") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_random(vec, &counter, 100000);
+    long long checksum = 0;
+    for (Base& item : vec) {
+        checksum += item.data * (item.get_type() == BaseT ? 1 : 3);
+    }
+
+    parallel_sort(vec, [](Base& item) { return item.data; }, 4);
+
+    bool sorted = true;
+    for (size_t index = 1; index < vec.size(); ++index) {
+        sorted &= vec[index - 1].data <= vec[index].data;
+    }
+    CHECK(sorted);
+    for (Base& item : vec) {
+        checksum -= item.data * (item.get_type() == BaseT ? 1 : 3);
+    }
+    CHECK(checksum == 0);
+    CHECK(counter.destructor_count == 0);
+}
+
+TEST_CASE("parallel_sort is stable") {
+    Counter counter;
+    PolyVector<Base> vec;
+    for (int i = 0; i < 50000; ++i) {
+        vec.emplace_back<Base>(&counter, i);
+    }
+
+    parallel_sort(vec, [](Base& item) { return item.data % 10; }, 4);
+
+    bool stable = true;
+    for (size_t index = 1; index < vec.size(); ++index) {
+        if (vec[index - 1].data % 10 == vec[index].data % 10) {
+            stable &= vec[index - 1].data < vec[index].data;
+        }
+        else {
+            stable &= vec[index - 1].data % 10 < vec[index].data % 10;
+        }
+    }
+    CHECK(stable);
+}
+
+TEST_CASE("parallel_sort floating point key") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_random(vec, &counter, 40000);
+
+    parallel_sort(vec, [](Base& item) { return item.data * -0.5; }, 3);
+
+    bool sorted = true;
+    for (size_t index = 1; index < vec.size(); ++index) {
+        sorted &= vec[index - 1].data >= vec[index].data;
+    }
+    CHECK(sorted);
+}
+
+TEST_CASE("parallel_sort comparison key") {
+    Counter counter;
+    PolyVector<Base> vec;
+    fill_random(vec, &counter, 40000);
+
+    parallel_sort(vec, [](Base& item) { return std::to_string(item.data); }, 3);
+
+    bool sorted = true;
+    for (size_t index = 1; index < vec.size(); ++index) {
+        sorted &= std::to_string(vec[index - 1].data) <= std::to_string(vec[index].data);
+    }
+    CHECK(sorted);
+    CHECK(vec.size() == 40000);
+}
+
+TEST_CASE("parallel_sort small vector") {
+    PolyVector<int> vec{3, -1, 2};
+    parallel_sort(vec, [](int& item) { return item; });
+
+    CHECK(vec[0] == -1);
+    CHECK(vec[1] == 2);
+    CHECK(vec[2] == 3);
+}
+TEST_SUITE_END();
+
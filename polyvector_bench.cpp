@@ -0,0 +1,1280 @@
+// Benchmarks for PolyVector and the containers built on it. Writes a JSON
+// report to stdout; see BenchReport for the command line.
+// Build with: g++ -std=c++20 -O2 -pthread polyvector_bench.cpp -o polyvector_bench
+#include <atomic>
+#include <malloc.h>
+#include <memory>
+#include <random>
+#include <variant>
+#include <sys/mman.h>
+#include "concurrent_polyvector.h"
+#include "polyringbuffer.h"
+#include "polyvector_algorithm.h"
+#include "polyvector_bench.h"
+#include "polyvector_prefetch.h"
+#include "sharded_polyvector.h"
+#include "typed_polyvector.h"
+
+// Messages
+
+struct Msg {
+    uint64_t sent_ns;
+    uint64_t payload;
+
+    Msg(uint64_t sent_ns_in, uint64_t payload_in) : sent_ns{sent_ns_in}, payload{payload_in} {};
+    virtual ~Msg() = default;
+    virtual uint64_t handle() = 0;
+};
+
+struct Tick : public Msg {
+    Tick(uint64_t sent_ns_in, uint64_t payload_in) : Msg(sent_ns_in, payload_in) {};
+    uint64_t handle() override {
+        return payload + 1;
+    }
+};
+
+struct Trade : public Msg {
+    Trade(uint64_t sent_ns_in, uint64_t payload_in) : Msg(sent_ns_in, payload_in) {};
+    uint64_t handle() override {
+        return payload * 3;
+    }
+};
+
+// Queue adaptors: messages stored in place, or as one heap allocation each
+
+constexpr size_t ring_capacity = 1024;
+
+template<RingMode Mode>
+struct InPlaceQueue {
+    PolyRingBuffer<Msg, ring_capacity, Mode> ring;
+
+    template<typename Derived>
+    bool try_send(uint64_t sent_ns, uint64_t payload) {
+        return ring.template try_emplace<Derived>(sent_ns, payload);
+    }
+
+    template<typename F>
+    bool try_receive(F&& f) {
+        return ring.consume([&](Msg& msg) { f(msg); });
+    }
+};
+
+template<RingMode Mode>
+struct UniquePtrQueue {
+    PolyRingBuffer<std::unique_ptr<Msg>, ring_capacity, Mode> ring;
+
+    template<typename Derived>
+    bool try_send(uint64_t sent_ns, uint64_t payload) {
+        return ring.template try_emplace<std::unique_ptr<Msg>>(std::make_unique<Derived>(sent_ns, payload));
+    }
+
+    template<typename F>
+    bool try_receive(F&& f) {
+        return ring.consume([&](std::unique_ptr<Msg>& msg) { f(*msg); });
+    }
+};
+
+template<typename Queue>
+static void bench_queue_throughput(BenchReport& report, const char* queue_name, size_t message_count) {
+    auto queue = std::make_unique<Queue>();
+
+    uint64_t start = now_ns();
+    std::thread producer([&] {
+        for (size_t i = 0; i < message_count; ++i) {
+            unsigned spins = 0;
+            if (i % 2 == 0) {
+                while (!queue->template try_send<Tick>(0, i)) {
+                    spin_pause(spins);
+                }
+            }
+            else {
+                while (!queue->template try_send<Trade>(0, i)) {
+                    spin_pause(spins);
+                }
+            }
+        }
+    });
+
+    uint64_t checksum = 0;
+    size_t received = 0;
+    unsigned spins = 0;
+    while (received < message_count) {
+        if (queue->try_receive([&](Msg& msg) { checksum += msg.handle(); })) {
+            ++received;
+        }
+        else {
+            spin_pause(spins);
+        }
+    }
+    producer.join();
+    uint64_t elapsed = now_ns() - start;
+    do_not_optimize(checksum);
+
+    report.add("ring", "throughput")
+        .param("queue", queue_name)
+        .param("messages", message_count)
+        .metric("mmsg_per_s", message_count * 1e3 / elapsed);
+}
+
+// One message in flight at a time, so the samples measure handoff latency
+// rather than queueing delay.
+template<typename Queue>
+static void bench_queue_latency(BenchReport& report, const char* queue_name, size_t message_count) {
+    auto queue = std::make_unique<Queue>();
+    std::atomic<size_t> acknowledged {0};
+    std::vector<uint64_t> samples;
+    samples.reserve(message_count);
+
+    std::thread producer([&] {
+        for (size_t i = 0; i < message_count; ++i) {
+            unsigned spins = 0;
+            while (!queue->template try_send<Tick>(now_ns(), i)) {
+                spin_pause(spins);
+            }
+            while (acknowledged.load(std::memory_order_acquire) <= i) {
+                spin_pause(spins);
+            }
+        }
+    });
+
+    unsigned spins = 0;
+    while (samples.size() < message_count) {
+        if (queue->try_receive([&](Msg& msg) { samples.push_back(now_ns() - msg.sent_ns); })) {
+            acknowledged.fetch_add(1, std::memory_order_release);
+        }
+        else {
+            spin_pause(spins);
+        }
+    }
+    producer.join();
+
+    report.add("ring", "latency")
+        .param("queue", queue_name)
+        .param("messages", message_count)
+        .metric("p50_ns", percentile(samples, 0.5))
+        .metric("p99_ns", percentile(samples, 0.99))
+        .metric("p999_ns", percentile(samples, 0.999));
+}
+
+// Shapes: four same-size types behind one virtual call
+
+struct Shape {
+    double a;
+    double b;
+
+    Shape(double a_in, double b_in) : a{a_in}, b{b_in} {};
+    virtual ~Shape() = default;
+    virtual double area() = 0;
+};
+
+struct Rect : public Shape {
+    Rect(double a_in, double b_in) : Shape(a_in, b_in) {};
+    double area() override {
+        return a * b;
+    }
+};
+
+struct Ellipse : public Shape {
+    Ellipse(double a_in, double b_in) : Shape(a_in, b_in) {};
+    double area() override {
+        return 3.14159265 * a * b;
+    }
+};
+
+struct Triangle : public Shape {
+    Triangle(double a_in, double b_in) : Shape(a_in, b_in) {};
+    double area() override {
+        return 0.5 * a * b;
+    }
+};
+
+struct Square : public Shape {
+    Square(double a_in, double b_in) : Shape(a_in, b_in) {};
+    double area() override {
+        return a * a;
+    }
+};
+
+// Fills with the four shape types randomly interleaved, as in arrival order
+static void fill_shapes(PolyVector<Shape>& shapes, size_t count) {
+    std::mt19937 random(42);
+    shapes.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        double a = static_cast<double>(i % 100);
+        switch (random() % 4) {
+            case 0: shapes.emplace_back<Rect>(a, 2.0); break;
+            case 1: shapes.emplace_back<Ellipse>(a, 2.0); break;
+            case 2: shapes.emplace_back<Triangle>(a, 2.0); break;
+            default: shapes.emplace_back<Square>(a, 2.0); break;
+        }
+    }
+}
+
+// Runs of each timed traversal, also the divisor for its counters
+constexpr size_t traversal_runs = 5;
+
+// Best of traversal_runs runs of f(), in nanoseconds per element, counting
+// every run into counters if given
+template<typename F>
+static double time_per_element(size_t count, F f, PerfCounters* counters = nullptr) {
+    return best_ns_per_element(traversal_runs, count, [] { return 0; }, [&](int&) {
+        do_not_optimize(f());
+    }, counters);
+}
+
+static double time_area_traversal(PolyVector<Shape>& shapes, PerfCounters* counters = nullptr) {
+    return time_per_element(shapes.size(), [&] {
+        double total = 0;
+        for (Shape& shape : shapes) {
+            total += shape.area();
+        }
+        return total;
+    }, counters);
+}
+
+template<typename Sort>
+static void bench_type_sort(BenchReport& report, const char* name, size_t count, Sort sort) {
+    PolyVector<Shape> shapes;
+    fill_shapes(shapes, count);
+
+    // Counters cover the sort and the traversal after it
+    PerfCounters* counters = report.counters();
+    double before = time_area_traversal(shapes);
+    double sort_ns = best_ns_per_element(1, count, [] { return 0; }, [&](int&) {
+        sort(shapes);
+    }, counters);
+    double after = time_area_traversal(shapes, counters);
+
+    report.add("type_sort", name)
+        .param("count", count)
+        .metric("traversal_before_ns_per_element", before)
+        .metric("traversal_after_ns_per_element", after)
+        .metric("sort_ns_per_element", sort_ns)
+        .counted(counters, static_cast<double>(traversal_runs + 1) * count);
+}
+
+// The same four shapes without a vtable, for index and variant dispatch
+
+struct PlainShape {
+    double a;
+    double b;
+
+    PlainShape(double a_in, double b_in) : a{a_in}, b{b_in} {};
+};
+
+struct PlainRect : public PlainShape {
+    PlainRect(double a_in, double b_in) : PlainShape(a_in, b_in) {};
+    double area() const {
+        return a * b;
+    }
+};
+
+struct PlainEllipse : public PlainShape {
+    PlainEllipse(double a_in, double b_in) : PlainShape(a_in, b_in) {};
+    double area() const {
+        return 3.14159265 * a * b;
+    }
+};
+
+struct PlainTriangle : public PlainShape {
+    PlainTriangle(double a_in, double b_in) : PlainShape(a_in, b_in) {};
+    double area() const {
+        return 0.5 * a * b;
+    }
+};
+
+struct PlainSquare : public PlainShape {
+    PlainSquare(double a_in, double b_in) : PlainShape(a_in, b_in) {};
+    double area() const {
+        return a * a;
+    }
+};
+
+using TypedShapes = TypedPolyVector<PlainShape, PlainRect, PlainEllipse, PlainTriangle, PlainSquare>;
+using VariantShape = std::variant<PlainRect, PlainEllipse, PlainTriangle, PlainSquare>;
+
+// Sums areas over the same random type sequence through a vtable, a one-byte
+// type index and std::variant
+static void bench_dispatch(BenchReport& report, size_t count) {
+    PolyVector<Shape> virtual_shapes;
+    fill_shapes(virtual_shapes, count);
+
+    TypedShapes typed_shapes;
+    std::vector<VariantShape> variant_shapes;
+    typed_shapes.reserve(count);
+    variant_shapes.reserve(count);
+    std::mt19937 random(42);
+    for (size_t i = 0; i < count; ++i) {
+        double a = static_cast<double>(i % 100);
+        switch (random() % 4) {
+            case 0: typed_shapes.emplace_back<PlainRect>(a, 2.0); variant_shapes.emplace_back(PlainRect(a, 2.0)); break;
+            case 1: typed_shapes.emplace_back<PlainEllipse>(a, 2.0); variant_shapes.emplace_back(PlainEllipse(a, 2.0)); break;
+            case 2: typed_shapes.emplace_back<PlainTriangle>(a, 2.0); variant_shapes.emplace_back(PlainTriangle(a, 2.0)); break;
+            default: typed_shapes.emplace_back<PlainSquare>(a, 2.0); variant_shapes.emplace_back(PlainSquare(a, 2.0)); break;
+        }
+    }
+
+    PerfCounters* counters = report.counters();
+    double operations = static_cast<double>(traversal_runs) * count;
+    double virtual_ns = time_area_traversal(virtual_shapes, counters);
+    report.add("dispatch", "virtual").param("count", count)
+        .metric("ns_per_element", virtual_ns).metric("bytes_per_element", sizeof(Shape))
+        .counted(counters, operations);
+    double typed_ns = time_per_element(count, [&] {
+        double total = 0;
+        typed_shapes.visit([&](auto& shape) { total += shape.area(); });
+        return total;
+    }, counters);
+    report.add("dispatch", "typed").param("count", count)
+        .metric("ns_per_element", typed_ns).metric("bytes_per_element", sizeof(PlainShape) + 1)
+        .counted(counters, operations);
+    double variant_ns = time_per_element(count, [&] {
+        double total = 0;
+        for (VariantShape& shape : variant_shapes) {
+            total += std::visit([](auto& item) { return item.area(); }, shape);
+        }
+        return total;
+    }, counters);
+    report.add("dispatch", "variant").param("count", count)
+        .metric("ns_per_element", variant_ns).metric("bytes_per_element", sizeof(VariantShape))
+        .counted(counters, operations);
+}
+
+// Large slots: one virtual call per element reading the first and last
+// cache line of its slot
+
+template<size_t Bytes>
+struct Blob {
+    uint64_t fields[(Bytes - sizeof(void*)) / sizeof(uint64_t)];
+
+    Blob(uint64_t seed) {
+        for (uint64_t& field : fields) {
+            field = seed++;
+        }
+    }
+    virtual ~Blob() = default;
+    virtual uint64_t visit() = 0;
+};
+
+template<size_t Bytes>
+struct SumBlob : public Blob<Bytes> {
+    SumBlob(uint64_t seed) : Blob<Bytes>(seed) {};
+    uint64_t visit() override {
+        return this->fields[0] + this->fields[std::size(this->fields) - 1];
+    }
+};
+
+template<size_t Bytes>
+struct XorBlob : public Blob<Bytes> {
+    XorBlob(uint64_t seed) : Blob<Bytes>(seed) {};
+    uint64_t visit() override {
+        return this->fields[0] ^ this->fields[std::size(this->fields) - 1];
+    }
+};
+
+// Traversal time per element over total_bytes of slots, for a range of
+// prefetch distances
+template<size_t Bytes>
+static void bench_prefetch_distance(BenchReport& report, size_t total_bytes) {
+    size_t count = total_bytes / Bytes;
+    PolyVector<Blob<Bytes>> blobs;
+    blobs.reserve(count);
+    std::mt19937 random(42);
+    for (size_t i = 0; i < count; ++i) {
+        if (random() % 2 == 0) {
+            blobs.template emplace_back<SumBlob<Bytes>>(i);
+        }
+        else {
+            blobs.template emplace_back<XorBlob<Bytes>>(i);
+        }
+    }
+
+    for (size_t distance : {size_t{0}, size_t{1}, size_t{2}, size_t{4}, size_t{8}, size_t{16}, size_t{32}}) {
+        double ns = time_per_element(count, [&] {
+            uint64_t total = 0;
+            for_each_prefetched(blobs, [&](Blob<Bytes>& blob) { total += blob.visit(); }, distance);
+            return static_cast<double>(total);
+        }, report.counters());
+        report.add("prefetch", "for_each_prefetched")
+            .param("slot_bytes", Bytes)
+            .param("distance", distance)
+            .param("default_distance", default_prefetch_distance<Blob<Bytes>>)
+            .metric("ns_per_element", ns)
+            .counted(report.counters(), static_cast<double>(traversal_runs) * count);
+    }
+}
+
+// Containers: PolyVector against the usual ways of storing polymorphic objects
+
+struct Item {
+    uint64_t key;
+    uint64_t weight;
+
+    Item(uint64_t key_in) : key{key_in}, weight{key_in * 3} {};
+    virtual ~Item() = default;
+    virtual uint64_t value() const {
+        return key;
+    }
+
+    bool operator==(const Item& other) const {
+        return key == other.key;
+    }
+};
+
+struct SumItem : public Item {
+    SumItem(uint64_t key_in) : Item(key_in) {};
+    uint64_t value() const override {
+        return key + weight;
+    }
+};
+
+struct ProductItem : public Item {
+    ProductItem(uint64_t key_in) : Item(key_in) {};
+    uint64_t value() const override {
+        return key * weight;
+    }
+};
+
+struct XorItem : public Item {
+    XorItem(uint64_t key_in) : Item(key_in) {};
+    uint64_t value() const override {
+        return key ^ weight;
+    }
+};
+
+// Counts the bytes every allocation through it holds, so the footprint suite
+// can see what a container asks of the heap. Counted<T> routes single objects
+// of T through the same counts.
+struct AllocationCounts {
+    inline static size_t live = 0;
+    inline static size_t peak = 0;
+    inline static size_t allocations = 0;
+
+    static void add(size_t bytes) {
+        live += bytes;
+        peak = std::max(peak, live);
+        ++allocations;
+    }
+
+    static void remove(size_t bytes) {
+        live -= bytes;
+    }
+
+    static void reset() {
+        live = 0;
+        peak = 0;
+        allocations = 0;
+    }
+};
+
+template<typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U>&) {};
+
+    T* allocate(size_t count) {
+        AllocationCounts::add(count * sizeof(T));
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T* data, size_t count) {
+        AllocationCounts::remove(count * sizeof(T));
+        std::allocator<T>().deallocate(data, count);
+    }
+
+    template<typename U>
+    bool operator==(const CountingAllocator<U>&) const {
+        return true;
+    }
+};
+
+// With a virtual destructor, deleting through a base pointer reaches the
+// sized operator delete of the dynamic type
+template<typename T>
+struct Counted : public T {
+    using T::T;
+
+    static void* operator new(size_t bytes) {
+        AllocationCounts::add(bytes);
+        return ::operator new(bytes);
+    }
+
+    static void operator delete(void* memory, size_t bytes) {
+        AllocationCounts::remove(bytes);
+        ::operator delete(memory);
+    }
+};
+
+// The type to heap-allocate a T as, for containers using Alloc
+template<template<typename> typename Alloc, typename T>
+struct heap_object {
+    using type = T;
+};
+
+template<typename T>
+struct heap_object<CountingAllocator, T> {
+    using type = Counted<T>;
+};
+
+template<template<typename> typename Alloc, typename T>
+using heap_object_t = typename heap_object<Alloc, T>::type;
+
+// Each adaptor stores Items its own way behind the same interface, drawing all
+// its memory through Alloc. type picks Item, SumItem, ProductItem or XorItem.
+
+template<template<typename> typename Alloc>
+struct BasicPolyVectorItems {
+    PolyVector<Item, Alloc<Item>> items;
+
+    void reserve(size_t count) {
+        items.reserve(count);
+    }
+
+    void push_back(uint64_t key) {
+        items.push_back(Item(key));
+    }
+
+    void emplace(uint8_t type, uint64_t key) {
+        switch (type) {
+            case 0: items.template emplace_back<Item>(key); break;
+            case 1: items.template emplace_back<SumItem>(key); break;
+            case 2: items.template emplace_back<ProductItem>(key); break;
+            default: items.template emplace_back<XorItem>(key); break;
+        }
+    }
+
+    uint64_t at(size_t index) {
+        return items[index].value();
+    }
+
+    uint64_t sum() {
+        uint64_t total = 0;
+        for (Item& item : items) {
+            total += item.value();
+        }
+        return total;
+    }
+
+    void erase_value(uint64_t key) {
+        items.erase_value(Item(key));
+    }
+
+    void clear() {
+        items.clear();
+    }
+};
+
+using PolyVectorItems = BasicPolyVectorItems<std::allocator>;
+
+template<template<typename> typename Alloc>
+struct BasicUniquePtrItems {
+    std::vector<std::unique_ptr<Item>, Alloc<std::unique_ptr<Item>>> items;
+
+    void reserve(size_t count) {
+        items.reserve(count);
+    }
+
+    void push_back(uint64_t key) {
+        items.push_back(std::make_unique<heap_object_t<Alloc, Item>>(key));
+    }
+
+    void emplace(uint8_t type, uint64_t key) {
+        switch (type) {
+            case 0: items.push_back(std::make_unique<heap_object_t<Alloc, Item>>(key)); break;
+            case 1: items.push_back(std::make_unique<heap_object_t<Alloc, SumItem>>(key)); break;
+            case 2: items.push_back(std::make_unique<heap_object_t<Alloc, ProductItem>>(key)); break;
+            default: items.push_back(std::make_unique<heap_object_t<Alloc, XorItem>>(key)); break;
+        }
+    }
+
+    uint64_t at(size_t index) {
+        return items[index]->value();
+    }
+
+    uint64_t sum() {
+        uint64_t total = 0;
+        for (std::unique_ptr<Item>& item : items) {
+            total += item->value();
+        }
+        return total;
+    }
+
+    void erase_value(uint64_t key) {
+        std::erase_if(items, [key](std::unique_ptr<Item>& item) { return item->key == key; });
+    }
+
+    void clear() {
+        items.clear();
+    }
+};
+
+using UniquePtrItems = BasicUniquePtrItems<std::allocator>;
+
+template<template<typename> typename Alloc>
+struct BasicVariantItems {
+    using Variant = std::variant<Item, SumItem, ProductItem, XorItem>;
+    std::vector<Variant, Alloc<Variant>> items;
+
+    void reserve(size_t count) {
+        items.reserve(count);
+    }
+
+    void push_back(uint64_t key) {
+        items.emplace_back(Item(key));
+    }
+
+    void emplace(uint8_t type, uint64_t key) {
+        switch (type) {
+            case 0: items.emplace_back(std::in_place_type<Item>, key); break;
+            case 1: items.emplace_back(std::in_place_type<SumItem>, key); break;
+            case 2: items.emplace_back(std::in_place_type<ProductItem>, key); break;
+            default: items.emplace_back(std::in_place_type<XorItem>, key); break;
+        }
+    }
+
+    uint64_t at(size_t index) {
+        return std::visit([](auto& item) { return item.value(); }, items[index]);
+    }
+
+    uint64_t sum() {
+        uint64_t total = 0;
+        for (auto& item : items) {
+            total += std::visit([](auto& alternative) { return alternative.value(); }, item);
+        }
+        return total;
+    }
+
+    void erase_value(uint64_t key) {
+        std::erase_if(items, [key](auto& item) {
+            return std::visit([key](auto& alternative) { return alternative.key == key; }, item);
+        });
+    }
+
+    void clear() {
+        items.clear();
+    }
+};
+
+using VariantItems = BasicVariantItems<std::allocator>;
+
+// Pointers into objects allocated in order from 4096-slot blocks. Slots are
+// not reused after erase, as with a typical bump pool.
+template<template<typename> typename Alloc>
+struct BasicPoolItems {
+    struct alignas(Item) Slot {
+        unsigned char bytes[sizeof(Item)];
+    };
+    static constexpr size_t block_slots = 4096;
+
+    std::vector<Item*, Alloc<Item*>> items;
+    std::vector<Slot*, Alloc<Slot*>> blocks;
+    size_t used {0};
+
+    ~BasicPoolItems() {
+        clear();
+        for (Slot* block : blocks) {
+            Alloc<Slot>().deallocate(block, block_slots);
+        }
+    }
+
+    void* allocate() {
+        if (used == blocks.size() * block_slots) {
+            blocks.push_back(Alloc<Slot>().allocate(block_slots));
+        }
+        void* slot = &blocks[used / block_slots][used % block_slots];
+        ++used;
+        return slot;
+    }
+
+    void reserve(size_t count) {
+        items.reserve(count);
+    }
+
+    void push_back(uint64_t key) {
+        items.push_back(new (allocate()) Item(key));
+    }
+
+    void emplace(uint8_t type, uint64_t key) {
+        switch (type) {
+            case 0: items.push_back(new (allocate()) Item(key)); break;
+            case 1: items.push_back(new (allocate()) SumItem(key)); break;
+            case 2: items.push_back(new (allocate()) ProductItem(key)); break;
+            default: items.push_back(new (allocate()) XorItem(key)); break;
+        }
+    }
+
+    uint64_t at(size_t index) {
+        return items[index]->value();
+    }
+
+    uint64_t sum() {
+        uint64_t total = 0;
+        for (Item* item : items) {
+            total += item->value();
+        }
+        return total;
+    }
+
+    void erase_value(uint64_t key) {
+        std::erase_if(items, [key](Item* item) {
+            if (item->key != key) {
+                return false;
+            }
+            item->~Item();
+            return true;
+        });
+    }
+
+    void clear() {
+        for (Item* item : items) {
+            item->~Item();
+        }
+        items.clear();
+        used = 0;
+    }
+};
+
+using PoolItems = BasicPoolItems<std::allocator>;
+
+static_assert(sizeof(SumItem) == sizeof(Item) && sizeof(ProductItem) == sizeof(Item) && sizeof(XorItem) == sizeof(Item));
+
+template<typename Items>
+static std::unique_ptr<Items> make_items(const std::vector<uint8_t>& types) {
+    auto items = std::make_unique<Items>();
+    for (size_t index = 0; index < types.size(); ++index) {
+        items->emplace(types[index], index % 4);
+    }
+    return items;
+}
+
+// Times each operation over count elements of the given type sequence. Keys
+// repeat every four elements, so erase_value removes a quarter of them.
+template<typename Items>
+static void bench_items(BenchReport& report, const char* container, const char* mix,
+                        const std::vector<uint8_t>& types, const std::vector<size_t>& probes) {
+    size_t count = types.size();
+    size_t runs = std::max<size_t>(3, (size_t{1} << 20) / count);
+    auto empty = [] { return std::make_unique<Items>(); };
+    auto reserved = [count] {
+        auto items = std::make_unique<Items>();
+        items->reserve(count);
+        return items;
+    };
+    auto filled = [&types] { return make_items<Items>(types); };
+    PerfCounters* counters = report.counters();
+    auto record = [&](const char* operation, double ns) {
+        report.add("containers", operation)
+            .param("container", container)
+            .param("mix", mix)
+            .param("count", count)
+            .metric("ns_per_element", ns)
+            .counted(counters, static_cast<double>(runs) * count);
+    };
+
+    record("push_back", best_ns_per_element(runs, count, reserved, [count](std::unique_ptr<Items>& items) {
+        for (size_t index = 0; index < count; ++index) {
+            items->push_back(index);
+        }
+    }, counters));
+    record("emplace_back", best_ns_per_element(runs, count, reserved, [&types](std::unique_ptr<Items>& items) {
+        for (size_t index = 0; index < types.size(); ++index) {
+            items->emplace(types[index], index);
+        }
+    }, counters));
+    record("growth", best_ns_per_element(runs, count, empty, [&types](std::unique_ptr<Items>& items) {
+        for (size_t index = 0; index < types.size(); ++index) {
+            items->emplace(types[index], index);
+        }
+    }, counters));
+    record("random_access", best_ns_per_element(runs, count, filled, [&probes](std::unique_ptr<Items>& items) {
+        uint64_t total = 0;
+        for (size_t probe : probes) {
+            total += items->at(probe);
+        }
+        do_not_optimize(total);
+    }, counters));
+    record("iterate", best_ns_per_element(runs, count, filled, [](std::unique_ptr<Items>& items) {
+        do_not_optimize(items->sum());
+    }, counters));
+    record("erase_value", best_ns_per_element(runs, count, filled, [](std::unique_ptr<Items>& items) {
+        items->erase_value(1);
+    }, counters));
+    record("clear", best_ns_per_element(runs, count, filled, [](std::unique_ptr<Items>& items) {
+        items->clear();
+    }, counters));
+}
+
+// Sizes run from L1-resident to well past the last level cache. The mixes are
+// a single derived type, and four types in random order.
+static void bench_containers(BenchReport& report) {
+    std::vector<size_t> counts = {size_t{1} << 10, size_t{1} << 14, size_t{1} << 18, size_t{1} << 22};
+    if (report.quick()) {
+        counts = {size_t{1} << 10, size_t{1} << 14};
+    }
+
+    for (size_t count : counts) {
+        std::mt19937 random(42);
+        std::vector<size_t> probes(count);
+        for (size_t& probe : probes) {
+            probe = random() % count;
+        }
+
+        for (const char* mix : {"single", "mixed4"}) {
+            std::vector<uint8_t> types(count, 1);
+            if (std::strcmp(mix, "mixed4") == 0) {
+                for (uint8_t& type : types) {
+                    type = random() % 4;
+                }
+            }
+            bench_items<PolyVectorItems>(report, "polyvector", mix, types, probes);
+            bench_items<UniquePtrItems>(report, "unique_ptr", mix, types, probes);
+            bench_items<VariantItems>(report, "variant", mix, types, probes);
+            bench_items<PoolItems>(report, "pool", mix, types, probes);
+        }
+    }
+}
+
+// Footprint: what each container holds in the heap and in resident memory per
+// element, after growth, after churn and after erasing half
+
+// Resident bytes gained since before, per element
+static double resident_per_element(size_t before, size_t count) {
+    return (static_cast<double>(resident_bytes()) - static_cast<double>(before)) / count;
+}
+
+// Keys repeat every eight elements. Growth appends count elements without
+// reserving. Churn then erases one key at a time and appends as many elements
+// again, eight times over. Last, half the keys are erased. Heap bytes come
+// from CountingAllocator; resident bytes also show the allocator's own
+// overhead and the pages it keeps.
+template<typename Items>
+static void bench_footprint(BenchReport& report, const char* container, const std::vector<uint8_t>& types) {
+    constexpr uint64_t keys = 8;
+    size_t count = types.size();
+    malloc_trim(0);
+    size_t before = resident_bytes();
+    AllocationCounts::reset();
+
+    auto items = std::make_unique<Items>();
+    for (size_t index = 0; index < count; ++index) {
+        items->emplace(types[index], index % keys);
+    }
+    double grown_bytes = static_cast<double>(AllocationCounts::live) / count;
+    double peak_to_live = static_cast<double>(AllocationCounts::peak) / AllocationCounts::live;
+    double allocations = static_cast<double>(AllocationCounts::allocations) / count;
+    double grown_resident = resident_per_element(before, count);
+
+    for (uint64_t key = 0; key < keys; ++key) {
+        items->erase_value(key);
+        for (size_t index = key; index < count; index += keys) {
+            items->emplace(types[index], key);
+        }
+    }
+    double churned_bytes = static_cast<double>(AllocationCounts::live) / count;
+    double churned_resident = resident_per_element(before, count);
+
+    for (uint64_t key = 0; key < keys / 2; ++key) {
+        items->erase_value(key);
+    }
+    size_t remaining = count - count / 2;
+    double halved_bytes = static_cast<double>(AllocationCounts::live) / remaining;
+    double halved_resident = resident_per_element(before, remaining);
+    items.reset();
+
+    report.add("footprint", container)
+        .param("count", count)
+        .param("element_bytes", sizeof(Item))
+        .metric("bytes_per_element", grown_bytes)
+        .metric("peak_to_live", peak_to_live)
+        .metric("allocations_per_element", allocations)
+        .metric("resident_bytes_per_element", grown_resident)
+        .metric("churn_bytes_per_element", churned_bytes)
+        .metric("churn_resident_bytes_per_element", churned_resident)
+        .metric("halved_bytes_per_element", halved_bytes)
+        .metric("halved_resident_bytes_per_element", halved_resident);
+}
+
+// Counts are not powers of two, so growth leaves the slack it usually does
+static void bench_footprints(BenchReport& report) {
+    std::vector<size_t> counts = {size_t{10'000}, size_t{300'000}, size_t{3'000'000}};
+    if (report.quick()) {
+        counts = {size_t{10'000}};
+    }
+    for (size_t count : counts) {
+        std::mt19937 random(42);
+        std::vector<uint8_t> types(count);
+        for (uint8_t& type : types) {
+            type = random() % 4;
+        }
+        bench_footprint<BasicPolyVectorItems<CountingAllocator>>(report, "polyvector", types);
+        bench_footprint<BasicUniquePtrItems<CountingAllocator>>(report, "unique_ptr", types);
+        bench_footprint<BasicVariantItems<CountingAllocator>>(report, "variant", types);
+        bench_footprint<BasicPoolItems<CountingAllocator>>(report, "pool", types);
+    }
+}
+
+// Append latency: each push_back and emplace_back timed on its own, to show
+// the spikes where a doubling PolyVector relocates every element into a new
+// block, against reserving up front and against ConcurrentPolyVector's
+// segments, which never relocate
+
+// Allocates whole pages with MAP_POPULATE, so a new block arrives already
+// faulted in and growth pays only for the relocation
+template<typename T>
+struct PopulatedAllocator {
+    using value_type = T;
+
+    T* allocate(size_t count) {
+        void* memory = mmap(nullptr, count * sizeof(T), PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* data, size_t count) {
+        munmap(data, count * sizeof(T));
+    }
+};
+
+template<typename Vector>
+static void emplace_item(Vector& items, uint8_t type, uint64_t key) {
+    switch (type) {
+        case 0: items.template emplace_back<Item>(key); break;
+        case 1: items.template emplace_back<SumItem>(key); break;
+        case 2: items.template emplace_back<ProductItem>(key); break;
+        default: items.template emplace_back<XorItem>(key); break;
+    }
+}
+
+static void record_latency(BenchReport& report, const char* name, const char* container, const char* growth,
+                           const char* allocator, size_t count, LatencyHistogram& histogram) {
+    report.add("append_latency", name)
+        .param("container", container)
+        .param("growth", growth)
+        .param("allocator", allocator)
+        .param("count", count)
+        .metric("samples", histogram.count())
+        .metric("mean_ns", histogram.mean())
+        .metric("p50_ns", histogram.percentile(0.5))
+        .metric("p90_ns", histogram.percentile(0.9))
+        .metric("p99_ns", histogram.percentile(0.99))
+        .metric("p999_ns", histogram.percentile(0.999))
+        .metric("p9999_ns", histogram.percentile(0.9999))
+        .metric("max_ns", histogram.max());
+}
+
+// runs fresh vectors of count appends each, all into one histogram per operation
+template<typename Vector>
+static void bench_append_latency(BenchReport& report, const char* container, const char* growth, const char* allocator,
+                                 size_t count, size_t runs, const std::vector<uint8_t>& types) {
+    LatencyHistogram push_back_ns;
+    LatencyHistogram emplace_back_ns;
+    bool reserved = std::strcmp(growth, "reserved") == 0;
+    for (size_t run = 0; run < runs; ++run) {
+        auto items = std::make_unique<Vector>();
+        if (reserved) {
+            items->reserve(count);
+        }
+        for (size_t index = 0; index < count; ++index) {
+            uint64_t start = now_ns();
+            items->push_back(Item(index));
+            push_back_ns.record(now_ns() - start);
+        }
+
+        items = std::make_unique<Vector>();
+        if (reserved) {
+            items->reserve(count);
+        }
+        for (size_t index = 0; index < count; ++index) {
+            uint64_t start = now_ns();
+            emplace_item(*items, types[index], index);
+            emplace_back_ns.record(now_ns() - start);
+        }
+    }
+    record_latency(report, "push_back", container, growth, allocator, count, push_back_ns);
+    record_latency(report, "emplace_back", container, growth, allocator, count, emplace_back_ns);
+}
+
+static void bench_append_latencies(BenchReport& report) {
+    size_t count = report.quick() ? size_t{1} << 16 : size_t{1} << 22;
+    size_t runs = report.quick() ? 1 : 5;
+    std::mt19937 random(42);
+    std::vector<uint8_t> types(count);
+    for (uint8_t& type : types) {
+        type = random() % 4;
+    }
+
+    // The cost of the two clock reads around every sample
+    LatencyHistogram clock_ns;
+    for (size_t index = 0; index < count; ++index) {
+        uint64_t start = now_ns();
+        clock_ns.record(now_ns() - start);
+    }
+    record_latency(report, "clock", "none", "none", "none", count, clock_ns);
+
+    using Populated = PopulatedAllocator<Item>;
+    bench_append_latency<PolyVector<Item>>(report, "polyvector", "doubling", "std", count, runs, types);
+    bench_append_latency<PolyVector<Item, Populated>>(report, "polyvector", "doubling", "populated", count, runs, types);
+    bench_append_latency<PolyVector<Item>>(report, "polyvector", "reserved", "std", count, runs, types);
+    bench_append_latency<PolyVector<Item, Populated>>(report, "polyvector", "reserved", "populated", count, runs, types);
+    bench_append_latency<ConcurrentPolyVector<Item>>(report, "concurrent", "segmented", "std", count, runs, types);
+    bench_append_latency<ConcurrentPolyVector<Item, Populated>>(report, "concurrent", "segmented", "populated", count, runs, types);
+}
+
+// Scaling: each workload at 1, 2, 4, ... threads up to the CPUs this process
+// may use, pinned one per CPU. Speedup is throughput over the throughput with
+// the fewest threads, and efficiency is speedup over the growth in threads.
+
+// Throughput at each thread count, and whether every thread was pinned
+struct ScalingSeries {
+    std::vector<size_t> threads;
+    std::vector<double> ops_per_s;
+    std::vector<bool> pinned;
+
+    template<typename Run>
+    void measure(size_t thread_count, Run run) {
+        size_t unpinned = unpinned_threads.load();
+        threads.push_back(thread_count);
+        ops_per_s.push_back(run());
+        pinned.push_back(unpinned_threads.load() == unpinned);
+    }
+};
+
+static void record_scaling(BenchReport& report, const char* name, const char* layout, const ScalingSeries& series) {
+    for (size_t index = 0; index < series.threads.size(); ++index) {
+        double speedup = series.ops_per_s[index] / series.ops_per_s[0];
+        report.add("scaling", name)
+            .param("layout", layout)
+            .param("threads", series.threads[index])
+            .param("pinned", series.pinned[index] ? "yes" : "no")
+            .metric("mops_per_s", series.ops_per_s[index] / 1e6)
+            .metric("speedup", speedup)
+            .metric("efficiency", speedup * series.threads[0] / series.threads[index]);
+    }
+}
+
+// Best of runs, in operations per second
+template<typename Run>
+static double best_ops_per_s(size_t runs, size_t operations, Run run) {
+    uint64_t best = UINT64_MAX;
+    for (size_t index = 0; index < runs; ++index) {
+        best = std::min(best, run());
+    }
+    return operations * 1e9 / std::max<uint64_t>(best, 1);
+}
+
+// Each thread makes a virtual call on every element of its own contiguous range
+static double parallel_traversal(PolyVector<Item>& items, size_t threads, size_t runs) {
+    size_t count = items.size();
+    return best_ops_per_s(runs, count, [&] {
+        return run_pinned(threads, [&](size_t thread) {
+            uint64_t total = 0;
+            for (size_t index = count * thread / threads; index < count * (thread + 1) / threads; ++index) {
+                total += items[index].value();
+            }
+            do_not_optimize(total);
+        });
+    });
+}
+
+// Each thread appends its share of count elements to its own shard
+static double sharded_append(const std::vector<uint8_t>& types, size_t threads, size_t runs) {
+    size_t count = types.size();
+    return best_ops_per_s(runs, count, [&] {
+        auto items = std::make_unique<ShardedPolyVector<Item>>();
+        return run_pinned(threads, [&](size_t thread) {
+            PolyVector<Item>& local = items->local();
+            for (size_t index = count * thread / threads; index < count * (thread + 1) / threads; ++index) {
+                emplace_item(local, types[index], index);
+            }
+        });
+    });
+}
+
+// Thread 0 appends count elements to a ConcurrentPolyVector while threads 1
+// to readers scan the published prefix until it is done. Throughput is
+// elements read.
+static double concurrent_readers(const std::vector<uint8_t>& types, size_t readers, size_t runs) {
+    size_t threads = readers + 1;
+    size_t count = types.size();
+    std::atomic<size_t> read {0};
+    uint64_t best = UINT64_MAX;
+    size_t best_read = 0;
+    for (size_t run = 0; run < runs; ++run) {
+        auto items = std::make_unique<ConcurrentPolyVector<Item>>();
+        std::atomic<bool> done {false};
+        read.store(0);
+        uint64_t elapsed = run_pinned(threads, [&](size_t thread) {
+            if (thread == 0) {
+                for (size_t index = 0; index < count; ++index) {
+                    emplace_item(*items, types[index], index);
+                }
+                done.store(true, std::memory_order_release);
+                return;
+            }
+            uint64_t total = 0;
+            size_t scanned = 0;
+            while (!done.load(std::memory_order_acquire)) {
+                size_t size = items->size();
+                for (size_t index = 0; index < size; ++index) {
+                    total += (*items)[index].value();
+                }
+                scanned += size;
+            }
+            do_not_optimize(total);
+            read.fetch_add(scanned);
+        });
+        if (elapsed < best) {
+            best = elapsed;
+            best_read = read.load();
+        }
+    }
+    return best_read * 1e9 / std::max<uint64_t>(best, 1);
+}
+
+// Counters one per thread, next to each other in a PolyVector or padded to a
+// cache line each
+struct Counter {
+    uint64_t count {0};
+
+    virtual ~Counter() = default;
+    virtual void bump() {
+        ++count;
+    }
+};
+
+struct alignas(64) PaddedCounter : public Counter {};
+
+// Each thread bumps its own counter, storing every increment
+template<typename Slot>
+static double counter_bumps(size_t iterations, size_t threads, size_t runs) {
+    return best_ops_per_s(runs, iterations * threads, [&] {
+        PolyVector<Slot> counters;
+        for (size_t thread = 0; thread < threads; ++thread) {
+            counters.template emplace_back<Slot>();
+        }
+        return run_pinned(threads, [&](size_t thread) {
+            Slot& counter = counters[thread];
+            for (size_t iteration = 0; iteration < iterations; ++iteration) {
+                counter.bump();
+                do_not_optimize(counter.count);
+            }
+        });
+    });
+}
+
+static void bench_scaling(BenchReport& report) {
+    size_t count = report.quick() ? size_t{1} << 18 : size_t{1} << 22;
+    size_t iterations = report.quick() ? size_t{1} << 20 : size_t{1} << 24;
+    size_t runs = report.quick() ? 1 : 3;
+    std::vector<size_t> thread_counts = scaling_thread_counts();
+    std::mt19937 random(42);
+    std::vector<uint8_t> types(count);
+    for (uint8_t& type : types) {
+        type = random() % 4;
+    }
+    PolyVector<Item> items;
+    items.reserve(count);
+    for (size_t index = 0; index < count; ++index) {
+        emplace_item(items, types[index], index);
+    }
+
+    ScalingSeries traversal;
+    ScalingSeries appends;
+    ScalingSeries reads;
+    ScalingSeries adjacent;
+    ScalingSeries padded;
+    for (size_t threads : thread_counts) {
+        traversal.measure(threads, [&] { return parallel_traversal(items, threads, runs); });
+        appends.measure(threads, [&] { return sharded_append(types, threads, runs); });
+        adjacent.measure(threads, [&] { return counter_bumps<Counter>(iterations, threads, runs); });
+        padded.measure(threads, [&] { return counter_bumps<PaddedCounter>(iterations, threads, runs); });
+        // One writer beside the readers, each on a CPU of its own where there
+        // are two or more, and threads counts them all
+        size_t readers = std::max<size_t>(1, std::min(threads, affinity_cpus().size() - 1));
+        if (reads.threads.empty() || reads.threads.back() != readers + 1) {
+            reads.measure(readers + 1, [&] { return concurrent_readers(types, readers, runs); });
+        }
+    }
+    record_scaling(report, "parallel_traversal", "polyvector", traversal);
+    record_scaling(report, "sharded_append", "sharded", appends);
+    record_scaling(report, "concurrent_readers", "concurrent", reads);
+    record_scaling(report, "counter_bump", "adjacent", adjacent);
+    record_scaling(report, "counter_bump", "padded", padded);
+    // Well above 1 with more than one thread means adjacent slots false share
+    for (size_t index = 0; index < thread_counts.size(); ++index) {
+        report.add("scaling", "false_sharing")
+            .param("threads", thread_counts[index])
+            .param("pinned", adjacent.pinned[index] && padded.pinned[index] ? "yes" : "no")
+            .metric("padded_over_adjacent", padded.ops_per_s[index] / adjacent.ops_per_s[index]);
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchReport report(argc, argv);
+    bool quick = report.quick();
+
+    if (report.enabled("containers")) {
+        bench_containers(report);
+    }
+
+    if (report.enabled("footprint")) {
+        bench_footprints(report);
+    }
+
+    if (report.enabled("scaling")) {
+        bench_scaling(report);
+    }
+
+    if (report.enabled("append_latency")) {
+        bench_append_latencies(report);
+    }
+
+    if (report.enabled("ring")) {
+        size_t throughput_messages = quick ? 100'000 : 2'000'000;
+        size_t latency_messages = quick ? 2'000 : 20'000;
+
+        bench_queue_throughput<InPlaceQueue<RingMode::spsc>>(report, "spsc/in_place", throughput_messages);
+        bench_queue_throughput<UniquePtrQueue<RingMode::spsc>>(report, "spsc/unique_ptr", throughput_messages);
+        bench_queue_throughput<InPlaceQueue<RingMode::mpmc>>(report, "mpmc/in_place", throughput_messages);
+        bench_queue_throughput<UniquePtrQueue<RingMode::mpmc>>(report, "mpmc/unique_ptr", throughput_messages);
+
+        bench_queue_latency<InPlaceQueue<RingMode::spsc>>(report, "spsc/in_place", latency_messages);
+        bench_queue_latency<UniquePtrQueue<RingMode::spsc>>(report, "spsc/unique_ptr", latency_messages);
+        bench_queue_latency<InPlaceQueue<RingMode::mpmc>>(report, "mpmc/in_place", latency_messages);
+        bench_queue_latency<UniquePtrQueue<RingMode::mpmc>>(report, "mpmc/unique_ptr", latency_messages);
+    }
+
+    std::vector<size_t> counts = {size_t{10'000}, size_t{1'000'000}};
+    if (quick) {
+        counts = {size_t{10'000}};
+    }
+
+    if (report.enabled("type_sort")) {
+        for (size_t count : counts) {
+            bench_type_sort(report, "sort_by_type", count, [](PolyVector<Shape>& shapes) { sort_by_type(shapes); });
+            bench_type_sort(report, "stable_sort_by_type", count, [](PolyVector<Shape>& shapes) { stable_sort_by_type(shapes); });
+        }
+    }
+
+    if (report.enabled("dispatch")) {
+        for (size_t count : counts) {
+            bench_dispatch(report, count);
+        }
+    }
+
+    if (report.enabled("prefetch")) {
+        size_t total_bytes = quick ? size_t{4} << 20 : size_t{64} << 20;
+        bench_prefetch_distance<128>(report, total_bytes);
+        bench_prefetch_distance<256>(report, total_bytes);
+        bench_prefetch_distance<512>(report, total_bytes);
+    }
+
+    report.write(stdout);
+    return 0;
+}
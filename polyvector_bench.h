@@ -0,0 +1,392 @@
+#ifndef POLYVECTOR_BENCH_H
+#define POLYVECTOR_BENCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "perf_counter_scope.h"
+
+// Harness shared by the benchmark suites in polyvector_bench.cpp: timing
+// helpers and a report that collects every case's parameters and metrics and
+// writes them as JSON.
+
+using bench_clock = std::chrono::steady_clock;
+
+inline uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()).count();
+}
+
+// Keeps the optimizer from discarding a computed value
+template<typename T>
+void do_not_optimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Backs off a failed spin so the other side can run when threads outnumber cores
+inline void spin_pause(unsigned& spins) {
+    if (++spins % 64 == 0) {
+        std::this_thread::yield();
+    }
+}
+
+inline uint64_t percentile(std::vector<uint64_t>& samples, double fraction) {
+    size_t index = static_cast<size_t>(fraction * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+// Pins the calling thread to one CPU. False where affinity can't be set.
+inline bool pin_to_cpu(size_t cpu) {
+#if defined(__linux__)
+    if (cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// The CPUs this process may run on, from its affinity mask when first called,
+// which must be before any thread is pinned. Where the mask is unavailable,
+// CPUs 0 up to the hardware thread count.
+inline const std::vector<size_t>& affinity_cpus() {
+    static const std::vector<size_t> cpus = [] {
+        std::vector<size_t> cpus;
+#if defined(__linux__)
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+#endif
+        if (cpus.empty()) {
+            for (size_t cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }();
+    return cpus;
+}
+
+// 1, 2, 4, ... up to and including the number of CPUs this process may use
+inline std::vector<size_t> scaling_thread_counts() {
+    size_t available = affinity_cpus().size();
+    std::vector<size_t> counts;
+    for (size_t threads = 1; threads < available; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(available);
+    return counts;
+}
+
+// Threads run_pinned couldn't pin, over the whole process
+inline std::atomic<size_t> unpinned_threads {0};
+
+// Runs work(thread) for every thread below threads, each pinned to the next
+// CPU of affinity_cpus(), wrapping around, and all released together once
+// they are ready. Threads that can't be pinned run anyway and are counted in
+// unpinned_threads. Returns nanoseconds from release until the last finishes.
+template<typename Work>
+uint64_t run_pinned(size_t threads, Work work) {
+    const std::vector<size_t>& cpus = affinity_cpus();
+    std::atomic<size_t> ready {0};
+    std::atomic<bool> go {false};
+    std::vector<std::thread> workers;
+    for (size_t thread = 0; thread < threads; ++thread) {
+        workers.emplace_back([&, thread] {
+            if (!pin_to_cpu(cpus[thread % cpus.size()])) {
+                unpinned_threads.fetch_add(1);
+            }
+            ready.fetch_add(1);
+            unsigned spins = 0;
+            while (!go.load(std::memory_order_acquire)) {
+                spin_pause(spins);
+            }
+            work(thread);
+        });
+    }
+    unsigned spins = 0;
+    while (ready.load() < threads) {
+        spin_pause(spins);
+    }
+    uint64_t start = now_ns();
+    go.store(true, std::memory_order_release);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return now_ns() - start;
+}
+
+// Resident set size from /proc/self/statm, or 0 where that is unavailable
+inline size_t resident_bytes() {
+    std::FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return 0;
+    }
+    unsigned long long total = 0;
+    unsigned long long resident = 0;
+    int read = std::fscanf(statm, "%llu %llu", &total, &resident);
+    std::fclose(statm);
+    return read == 2 ? resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+}
+
+// Log-linear histogram of samples in the style of HdrHistogram. Values below
+// 2^sub_bits get a bucket each, and above that every power of two is split
+// into 2^sub_bits buckets, so a percentile is within 1/128 of the true sample
+// however long the tail. Recording is a few instructions and never allocates.
+class LatencyHistogram {
+public:
+    LatencyHistogram() : buckets_((64 - sub_bits + 1) << sub_bits) {};
+
+    void record(uint64_t value) {
+        ++buckets_[bucket_of(value)];
+        ++count_;
+        total_ += value;
+        max_ = std::max(max_, value);
+    }
+
+    uint64_t count() {
+        return count_;
+    }
+
+    uint64_t max() {
+        return max_;
+    }
+
+    double mean() {
+        return count_ == 0 ? 0 : static_cast<double>(total_) / count_;
+    }
+
+    // Highest value in the bucket holding the sample at fraction of the way
+    // through the sorted samples
+    uint64_t percentile(double fraction) {
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * count_)));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < buckets_.size(); ++bucket) {
+            seen += buckets_[bucket];
+            if (seen >= rank) {
+                return std::min(highest_in(bucket), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    static constexpr unsigned sub_bits = 7;
+    static constexpr uint64_t sub_count = uint64_t{1} << sub_bits;
+
+    std::vector<uint64_t> buckets_;
+    uint64_t count_ {0};
+    uint64_t total_ {0};
+    uint64_t max_ {0};
+
+    static size_t bucket_of(uint64_t value) {
+        if (value < sub_count) {
+            return value;
+        }
+        unsigned shift = std::bit_width(value) - 1 - sub_bits;
+        return ((shift + 1) << sub_bits) + ((value >> shift) - sub_count);
+    }
+
+    static uint64_t highest_in(size_t bucket) {
+        if (bucket < sub_count) {
+            return bucket;
+        }
+        unsigned shift = (bucket >> sub_bits) - 1;
+        uint64_t leading = (bucket & (sub_count - 1)) + sub_count;
+        return ((leading + 1) << shift) - 1;
+    }
+};
+
+// Fastest of runs, in nanoseconds per element. setup() builds fresh state
+// outside the timed region and timed(state) is the measured work, which is
+// also counted into counters if given.
+template<typename Setup, typename Timed>
+double best_ns_per_element(size_t runs, size_t count, Setup setup, Timed timed, PerfCounters* counters = nullptr) {
+    double best = INFINITY;
+    for (size_t run = 0; run < runs; ++run) {
+        auto state = setup();
+        uint64_t elapsed;
+        if (counters != nullptr) {
+            PerfCounterScope scope(*counters);
+            uint64_t start = now_ns();
+            timed(state);
+            elapsed = now_ns() - start;
+        }
+        else {
+            uint64_t start = now_ns();
+            timed(state);
+            elapsed = now_ns() - start;
+        }
+        best = std::min(best, static_cast<double>(elapsed) / std::max<size_t>(count, 1));
+    }
+    return best;
+}
+
+// One benchmark case: string or integer parameters that identify it, numeric
+// metrics, and hardware counters per operation where they were measured
+struct BenchResult {
+    std::string suite;
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> params;
+    std::vector<std::pair<std::string, double>> metrics;
+    std::optional<std::vector<std::pair<std::string, double>>> counters;
+
+    BenchResult& param(const char* key, const char* value) {
+        params.emplace_back(key, quote(value));
+        return *this;
+    }
+
+    BenchResult& param(const char* key, size_t value) {
+        params.emplace_back(key, std::to_string(value));
+        return *this;
+    }
+
+    BenchResult& metric(const char* key, double value) {
+        metrics.emplace_back(key, value);
+        return *this;
+    }
+
+    // Takes the totals counted so far, averaged over operations. Does nothing
+    // if counting is off.
+    BenchResult& counted(PerfCounters* source, double operations) {
+        if (source != nullptr) {
+            counters = source->take(operations);
+        }
+        return *this;
+    }
+
+    static std::string quote(const std::string& text) {
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+};
+
+// Collects results for the suites selected on the command line:
+//   polyvector_bench [--quick] [--no-counters] [suite...]
+// With no suites named, every suite runs. --quick shrinks sizes for a smoke
+// test and --no-counters skips hardware counters. Progress goes to stderr and
+// the JSON report to stdout.
+class BenchReport {
+public:
+    BenchReport(int argc, char** argv) {
+        bool count = true;
+        for (int index = 1; index < argc; ++index) {
+            if (std::strcmp(argv[index], "--quick") == 0) {
+                quick_ = true;
+            }
+            else if (std::strcmp(argv[index], "--no-counters") == 0) {
+                count = false;
+            }
+            else {
+                suites_.emplace_back(argv[index]);
+            }
+        }
+        if (count) {
+            counters_ = std::make_unique<PerfCounters>();
+            if (!counters_->available()) {
+                std::fprintf(stderr, "performance counters unavailable\n");
+            }
+        }
+    }
+
+    // Null when counting is off
+    PerfCounters* counters() {
+        return counters_.get();
+    }
+
+    bool enabled(const char* suite) {
+        return suites_.empty() || std::find(suites_.begin(), suites_.end(), suite) != suites_.end();
+    }
+
+    bool quick() {
+        return quick_;
+    }
+
+    // The returned reference stays valid as more results are added
+    BenchResult& add(const char* suite, const char* name) {
+        std::fprintf(stderr, "%s/%s\n", suite, name);
+        results_.push_back(BenchResult{suite, name, {}, {}, {}});
+        return results_.back();
+    }
+
+    void write(std::FILE* out) {
+        std::fprintf(out, "{\n  \"benchmark\": \"polyvector_bench\",\n  \"quick\": %s,\n  \"results\": [",
+                     quick_ ? "true" : "false");
+        for (size_t index = 0; index < results_.size(); ++index) {
+            BenchResult& result = results_[index];
+            std::fprintf(out, "%s\n    {\"suite\": %s, \"name\": %s, \"params\": {", index == 0 ? "" : ",",
+                         BenchResult::quote(result.suite).c_str(), BenchResult::quote(result.name).c_str());
+            for (size_t param = 0; param < result.params.size(); ++param) {
+                std::fprintf(out, "%s%s: %s", param == 0 ? "" : ", ",
+                             BenchResult::quote(result.params[param].first).c_str(), result.params[param].second.c_str());
+            }
+            std::fprintf(out, "}, \"metrics\": {");
+            for (size_t metric = 0; metric < result.metrics.size(); ++metric) {
+                auto& [key, value] = result.metrics[metric];
+                std::fprintf(out, "%s%s: ", metric == 0 ? "" : ", ", BenchResult::quote(key).c_str());
+                write_number(out, value);
+            }
+            std::fprintf(out, "}");
+            if (result.counters) {
+                std::fprintf(out, ", \"counters\": {");
+                for (size_t counter = 0; counter < result.counters->size(); ++counter) {
+                    auto& [key, value] = (*result.counters)[counter];
+                    std::fprintf(out, "%s%s: ", counter == 0 ? "" : ", ", BenchResult::quote(key).c_str());
+                    write_number(out, value);
+                }
+                std::fprintf(out, "}");
+            }
+            std::fprintf(out, "}");
+        }
+        std::fprintf(out, "\n  ]\n}\n");
+    }
+
+private:
+    bool quick_ {false};
+    std::vector<std::string> suites_;
+    std::unique_ptr<PerfCounters> counters_;
+    std::deque<BenchResult> results_;
+
+    // JSON has no NaN or infinity, so those are written as null
+    static void write_number(std::FILE* out, double value) {
+        if (std::isfinite(value)) {
+            std::fprintf(out, "%.6g", value);
+        }
+        else {
+            std::fprintf(out, "null");
+        }
+    }
+};
+
+#endif
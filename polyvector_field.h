@@ -0,0 +1,322 @@
+#ifndef POLYVECTOR_FIELD_H
+#define POLYVECTOR_FIELD_H
+
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+#include "polyvector.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define POLYVECTOR_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define POLYVECTOR_X86_SIMD 0
+#endif
+
+// Reductions over one Base field of every element, reading it in place with a
+// stride of the slot size rather than from a mirrored column. Sums, minimums
+// and maximums of int32_t, float and double fields use AVX-512 or AVX2
+// gathers when the CPU has them, chosen at runtime; everything else, and
+// every other CPU, uses a scalar loop with software prefetch.
+// Floating point sums are accumulated in a different order on each path, so
+// they may differ in the last bits.
+
+enum class FieldOp {sum, min, max};
+enum class SimdLevel {scalar, avx2, avx512};
+
+template<typename Field>
+concept simd_field = std::is_same_v<Field, int32_t> || std::is_same_v<Field, float> || std::is_same_v<Field, double>;
+
+// Best level this CPU supports, detected once
+inline SimdLevel simd_level() {
+#if POLYVECTOR_X86_SIMD
+    static const SimdLevel level = __builtin_cpu_supports("avx512f") ? SimdLevel::avx512
+        : __builtin_cpu_supports("avx2") ? SimdLevel::avx2
+        : SimdLevel::scalar;
+    return level;
+#else
+    return SimdLevel::scalar;
+#endif
+}
+
+template<FieldOp Op, typename Field>
+Field combine_field(Field left, Field right) {
+    if constexpr (Op == FieldOp::sum) {
+        return left + right;
+    }
+    else if constexpr (Op == FieldOp::min) {
+        return right < left ? right : left;
+    }
+    else {
+        return left < right ? right : left;
+    }
+}
+
+template<typename Field>
+Field load_field(const char* address) {
+    Field value;
+    std::memcpy(&value, address, sizeof(Field));
+    return value;
+}
+
+// Left-folds op over count fields stride bytes apart, in order, prefetching a
+// few slots ahead
+template<typename Field, typename Op>
+Field fold_strided_scalar(const char* first, size_t stride, size_t count, Field init, Op op) {
+    constexpr size_t prefetch_slots = 16;
+    for (size_t index = 0; index < count; ++index) {
+        const char* address = first + index * stride;
+        __builtin_prefetch(address + prefetch_slots * stride);
+        init = op(init, load_field<Field>(address));
+    }
+    return init;
+}
+
+// Folds op over count fields stride bytes apart into four partial results so
+// the loads overlap, prefetching a few slots ahead. This regroups and reorders
+// the fold, so op must be associative and commutative.
+template<typename Field, typename Op>
+Field reduce_strided_scalar(const char* first, size_t stride, size_t count, Field init, Op op) {
+    constexpr size_t prefetch_slots = 16;
+    size_t index = 0;
+    if (count >= 4) {
+        Field partial[4] = {load_field<Field>(first), load_field<Field>(first + stride),
+                            load_field<Field>(first + 2 * stride), load_field<Field>(first + 3 * stride)};
+        for (index = 4; index + 4 <= count; index += 4) {
+            const char* address = first + index * stride;
+            __builtin_prefetch(address + prefetch_slots * stride);
+            partial[0] = op(partial[0], load_field<Field>(address));
+            partial[1] = op(partial[1], load_field<Field>(address + stride));
+            partial[2] = op(partial[2], load_field<Field>(address + 2 * stride));
+            partial[3] = op(partial[3], load_field<Field>(address + 3 * stride));
+        }
+        init = op(init, op(op(partial[0], partial[1]), op(partial[2], partial[3])));
+    }
+    for (; index < count; ++index) {
+        init = op(init, load_field<Field>(first + index * stride));
+    }
+    return init;
+}
+
+#if POLYVECTOR_X86_SIMD
+
+template<FieldOp Op, typename Field>
+__attribute__((target("avx2")))
+Field reduce_strided_avx2(const char* first, size_t stride, size_t count, Field init) {
+    auto combine = [](Field left, Field right) { return combine_field<Op>(left, right); };
+    constexpr size_t lanes = sizeof(Field) == 4 ? 8 : 4;
+    if (count < lanes) {
+        return reduce_strided_scalar(first, stride, count, init, combine);
+    }
+
+    // Masked gathers with a zeroed source behave as the unmasked ones, which
+    // GCC warns read an uninitialized source register
+    alignas(32) Field partial[lanes];
+    size_t index = lanes;
+    int step = static_cast<int>(stride);
+    if constexpr (std::is_same_v<Field, int32_t>) {
+        __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+        __m256i all = _mm256_set1_epi32(-1);
+        __m256i accumulator = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(first),
+                                                          offsets, all, 1);
+        for (; index + lanes <= count; index += lanes) {
+            __m256i values = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(),
+                                                         reinterpret_cast<const int*>(first + index * stride),
+                                                         offsets, all, 1);
+            accumulator = Op == FieldOp::sum ? _mm256_add_epi32(accumulator, values)
+                : Op == FieldOp::min ? _mm256_min_epi32(accumulator, values)
+                : _mm256_max_epi32(accumulator, values);
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i*>(partial), accumulator);
+    }
+    else if constexpr (std::is_same_v<Field, float>) {
+        __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+        __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256 accumulator = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), reinterpret_cast<const float*>(first),
+                                                      offsets, all, 1);
+        for (; index + lanes <= count; index += lanes) {
+            __m256 values = _mm256_mask_i32gather_ps(_mm256_setzero_ps(),
+                                                     reinterpret_cast<const float*>(first + index * stride),
+                                                     offsets, all, 1);
+            accumulator = Op == FieldOp::sum ? _mm256_add_ps(accumulator, values)
+                : Op == FieldOp::min ? _mm256_min_ps(accumulator, values)
+                : _mm256_max_ps(accumulator, values);
+        }
+        _mm256_store_ps(partial, accumulator);
+    }
+    else {
+        __m128i offsets = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(step));
+        __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        __m256d accumulator = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), reinterpret_cast<const double*>(first),
+                                                       offsets, all, 1);
+        for (; index + lanes <= count; index += lanes) {
+            __m256d values = _mm256_mask_i32gather_pd(_mm256_setzero_pd(),
+                                                      reinterpret_cast<const double*>(first + index * stride),
+                                                      offsets, all, 1);
+            accumulator = Op == FieldOp::sum ? _mm256_add_pd(accumulator, values)
+                : Op == FieldOp::min ? _mm256_min_pd(accumulator, values)
+                : _mm256_max_pd(accumulator, values);
+        }
+        _mm256_store_pd(partial, accumulator);
+    }
+
+    for (Field value : partial) {
+        init = combine(init, value);
+    }
+    return reduce_strided_scalar(first + index * stride, stride, count - index, init, combine);
+}
+
+template<FieldOp Op, typename Field>
+__attribute__((target("avx512f")))
+Field reduce_strided_avx512(const char* first, size_t stride, size_t count, Field init) {
+    auto combine = [](Field left, Field right) { return combine_field<Op>(left, right); };
+    constexpr size_t lanes = sizeof(Field) == 4 ? 16 : 8;
+    if (count < lanes) {
+        return reduce_strided_scalar(first, stride, count, init, combine);
+    }
+
+    // Full masks throughout, for the same warning as in reduce_strided_avx2;
+    // the unmasked min and max have it too
+    alignas(64) Field partial[lanes];
+    size_t index = lanes;
+    int step = static_cast<int>(stride);
+    if constexpr (std::is_same_v<Field, int32_t>) {
+        __m512i offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                             _mm512_set1_epi32(step));
+        __m512i accumulator = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, offsets, first, 1);
+        for (; index + lanes <= count; index += lanes) {
+            __m512i values = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, offsets, first + index * stride, 1);
+            accumulator = Op == FieldOp::sum ? _mm512_add_epi32(accumulator, values)
+                : Op == FieldOp::min ? _mm512_mask_min_epi32(accumulator, 0xFFFF, accumulator, values)
+                : _mm512_mask_max_epi32(accumulator, 0xFFFF, accumulator, values);
+        }
+        _mm512_store_si512(partial, accumulator);
+    }
+    else if constexpr (std::is_same_v<Field, float>) {
+        __m512i offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                             _mm512_set1_epi32(step));
+        __m512 accumulator = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, offsets, first, 1);
+        for (; index + lanes <= count; index += lanes) {
+            __m512 values = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, offsets, first + index * stride, 1);
+            accumulator = Op == FieldOp::sum ? _mm512_add_ps(accumulator, values)
+                : Op == FieldOp::min ? _mm512_mask_min_ps(accumulator, 0xFFFF, accumulator, values)
+                : _mm512_mask_max_ps(accumulator, 0xFFFF, accumulator, values);
+        }
+        _mm512_store_ps(partial, accumulator);
+    }
+    else {
+        __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+        __m512d accumulator = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, offsets, first, 1);
+        for (; index + lanes <= count; index += lanes) {
+            __m512d values = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, offsets, first + index * stride, 1);
+            accumulator = Op == FieldOp::sum ? _mm512_add_pd(accumulator, values)
+                : Op == FieldOp::min ? _mm512_mask_min_pd(accumulator, 0xFF, accumulator, values)
+                : _mm512_mask_max_pd(accumulator, 0xFF, accumulator, values);
+        }
+        _mm512_store_pd(partial, accumulator);
+    }
+
+    for (Field value : partial) {
+        init = combine(init, value);
+    }
+    return reduce_strided_scalar(first + index * stride, stride, count - index, init, combine);
+}
+
+#endif
+
+// Folds Op over count fields stride bytes apart using the given level, which
+// must be no higher than simd_level()
+template<FieldOp Op, typename Field>
+Field reduce_strided(SimdLevel level, const char* first, size_t stride, size_t count, Field init) {
+#if POLYVECTOR_X86_SIMD
+    if constexpr (simd_field<Field>) {
+        // Gather offsets are 32-bit
+        if (stride <= INT32_MAX / 16) {
+            if (level == SimdLevel::avx512) {
+                return reduce_strided_avx512<Op>(first, stride, count, init);
+            }
+            if (level == SimdLevel::avx2) {
+                return reduce_strided_avx2<Op>(first, stride, count, init);
+            }
+        }
+    }
+#endif
+    (void)level;
+    return reduce_strided_scalar(first, stride, count, init,
+                                 [](Field left, Field right) { return combine_field<Op>(left, right); });
+}
+
+template<typename Base, typename Allocator, typename Stats, typename Field>
+const char* first_field(PolyVector<Base, Allocator, Stats>& vec, Field Base::* member) {
+    return reinterpret_cast<const char*>(std::addressof(vec[0].*member));
+}
+
+// Left-folds op over member of every element in order, starting from init.
+// std::plus sums take the SIMD path and std::multiplies products are split
+// into partial products, so either may regroup floating point results.
+template<typename Base, typename Allocator, typename Stats, typename Field, typename Op>
+Field reduce_field(PolyVector<Base, Allocator, Stats>& vec, Field Base::* member, Op op, Field init = Field{}) {
+    if (vec.size() == 0) {
+        return init;
+    }
+    if constexpr (std::is_same_v<Op, std::plus<>> || std::is_same_v<Op, std::plus<Field>>) {
+        return reduce_strided<FieldOp::sum>(simd_level(), first_field(vec, member), sizeof(Base), vec.size(), init);
+    }
+    else if constexpr (std::is_same_v<Op, std::multiplies<>> || std::is_same_v<Op, std::multiplies<Field>>) {
+        return reduce_strided_scalar(first_field(vec, member), sizeof(Base), vec.size(), init, op);
+    }
+    else {
+        return fold_strided_scalar(first_field(vec, member), sizeof(Base), vec.size(), init, op);
+    }
+}
+
+template<typename Base, typename Allocator, typename Stats, typename Field>
+Field sum_field(PolyVector<Base, Allocator, Stats>& vec, Field Base::* member) {
+    return reduce_field(vec, member, std::plus<>{});
+}
+
+// Field{} for an empty vector
+template<typename Base, typename Allocator, typename Stats, typename Field>
+Field min_field(PolyVector<Base, Allocator, Stats>& vec, Field Base::* member) {
+    if (vec.size() == 0) {
+        return Field{};
+    }
+    return reduce_strided<FieldOp::min>(simd_level(), first_field(vec, member), sizeof(Base), vec.size(), vec[0].*member);
+}
+
+// Field{} for an empty vector
+template<typename Base, typename Allocator, typename Stats, typename Field>
+Field max_field(PolyVector<Base, Allocator, Stats>& vec, Field Base::* member) {
+    if (vec.size() == 0) {
+        return Field{};
+    }
+    return reduce_strided<FieldOp::max>(simd_level(), first_field(vec, member), sizeof(Base), vec.size(), vec[0].*member);
+}
+
+// Counts member values in bins equal-width bins over [low, high). Values
+// outside the range are not counted.
+template<typename Base, typename Allocator, typename Stats, typename Field>
+std::vector<size_t> field_histogram(PolyVector<Base, Allocator, Stats>& vec, Field Base::* member, Field low, Field high, size_t bins) {
+    std::vector<size_t> counts(bins, 0);
+    if (vec.size() == 0 || bins == 0 || !(low < high)) {
+        return counts;
+    }
+
+    constexpr size_t prefetch_slots = 16;
+    const char* first = first_field(vec, member);
+    double scale = static_cast<double>(bins) / (static_cast<double>(high) - static_cast<double>(low));
+    for (size_t index = 0; index < vec.size(); ++index) {
+        const char* address = first + index * sizeof(Base);
+        __builtin_prefetch(address + prefetch_slots * sizeof(Base));
+        Field value = load_field<Field>(address);
+        if (value < low || !(value < high)) {
+            continue;
+        }
+        size_t bin = static_cast<size_t>((static_cast<double>(value) - static_cast<double>(low)) * scale);
+        ++counts[bin < bins ? bin : bins - 1];
+    }
+    return counts;
+}
+
+#endif
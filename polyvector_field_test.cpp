@@ -0,0 +1,136 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <cmath>
+#include "polyvector_field.h"
+
+enum Type {BaseT, DerivedT};
+
+class Base {
+public:
+    int data;
+    float weight;
+    double value;
+
+    Base(int data_in, float weight_in, double value_in) : data{data_in}, weight{weight_in}, value{value_in} {};
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in, float weight_in, double value_in) : Base(data_in, weight_in, value_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+// Values with a minimum and maximum away from either end
+static void fill(PolyVector<Base>& vec, int count) {
+    for (int i = 0; i < count; ++i) {
+        int data = (i * 37) % 101 - 50;
+        if (i % 2 == 0) {
+            vec.emplace_back<Base>(data, data * 0.25f, data * 0.5);
+        }
+        else {
+            vec.emplace_back<Derived>(data, data * 0.25f, data * 0.5);
+        }
+    }
+}
+
+template<FieldOp Op, typename Field>
+static bool levels_agree(PolyVector<Base>& vec, Field Base::* member, Field init) {
+    const char* first = reinterpret_cast<const char*>(&(vec[0].*member));
+    Field expected = reduce_strided<Op>(SimdLevel::scalar, first, sizeof(Base), vec.size(), init);
+    bool agree = true;
+    for (SimdLevel level : {SimdLevel::avx2, SimdLevel::avx512}) {
+        if (level <= simd_level()) {
+            Field result = reduce_strided<Op>(level, first, sizeof(Base), vec.size(), init);
+            agree &= std::abs(static_cast<double>(result - expected)) < 1e-3;
+        }
+    }
+    return agree;
+}
+
+TEST_SUITE_BEGIN("Field reductions");
+TEST_CASE("sum, min and max") {
+    PolyVector<Base> vec;
+    fill(vec, 1000);
+
+    int sum = 0;
+    int low = vec[0].data;
+    int high = vec[0].data;
+    for (Base& item : vec) {
+        sum += item.data;
+        low = std::min(low, item.data);
+        high = std::max(high, item.data);
+    }
+
+    CHECK(sum_field(vec, &Base::data) == sum);
+    CHECK(min_field(vec, &Base::data) == low);
+    CHECK(max_field(vec, &Base::data) == high);
+    CHECK(sum_field(vec, &Base::value) == doctest::Approx(sum * 0.5));
+    CHECK(min_field(vec, &Base::weight) == low * 0.25f);
+    CHECK(max_field(vec, &Base::value) == high * 0.5);
+}
+
+TEST_CASE("Every SIMD level matches the scalar loop") {
+    for (int count : {1, 3, 7, 8, 15, 16, 17, 33, 100, 1001}) {
+        PolyVector<Base> vec;
+        fill(vec, count);
+        CHECK(levels_agree<FieldOp::sum>(vec, &Base::data, 0));
+        CHECK(levels_agree<FieldOp::min>(vec, &Base::data, vec[0].data));
+        CHECK(levels_agree<FieldOp::max>(vec, &Base::data, vec[0].data));
+        CHECK(levels_agree<FieldOp::sum>(vec, &Base::weight, 0.0f));
+        CHECK(levels_agree<FieldOp::min>(vec, &Base::weight, vec[0].weight));
+        CHECK(levels_agree<FieldOp::max>(vec, &Base::weight, vec[0].weight));
+        CHECK(levels_agree<FieldOp::sum>(vec, &Base::value, 0.0));
+        CHECK(levels_agree<FieldOp::min>(vec, &Base::value, vec[0].value));
+        CHECK(levels_agree<FieldOp::max>(vec, &Base::value, vec[0].value));
+    }
+}
+
+TEST_CASE("reduce_field with any op") {
+    PolyVector<Base> vec;
+    for (int i = 0; i < 10; ++i) {
+        vec.emplace_back<Derived>(1 << i, 0.0f, 0.0);
+    }
+    CHECK(reduce_field(vec, &Base::data, std::bit_or<>{}) == 1023);
+    CHECK(reduce_field(vec, &Base::data, std::plus<>{}, 5) == 1028);
+}
+
+TEST_CASE("reduce_field folds left in order") {
+    PolyVector<Base> vec;
+    for (int i = 0; i < 1000; ++i) {
+        vec.emplace_back<Base>(i, 0.0f, 0.0);
+    }
+    CHECK(reduce_field(vec, &Base::data, std::minus<>{}, 100) == 100 - 499500);
+
+    // Keeps the last three elements in order, so any regrouping shows
+    auto last_three = [](int digits, int data) { return digits % 1000000 * 1000 + data; };
+    CHECK(reduce_field(vec, &Base::data, last_three, 7) == 997998999);
+}
+
+TEST_CASE("Empty vector") {
+    PolyVector<Base> vec;
+    CHECK(sum_field(vec, &Base::data) == 0);
+    CHECK(min_field(vec, &Base::value) == 0.0);
+    CHECK(reduce_field(vec, &Base::data, std::multiplies<>{}, 1) == 1);
+    CHECK(field_histogram(vec, &Base::data, 0, 10, 5) == std::vector<size_t>(5, 0));
+}
+
+TEST_CASE("field_histogram") {
+    PolyVector<Base> vec;
+    for (int i = -5; i < 25; ++i) {
+        vec.emplace_back<Base>(i, 0.0f, i * 0.1);
+    }
+    CHECK(field_histogram(vec, &Base::data, 0, 20, 4) == std::vector<size_t>{5, 5, 5, 5});
+    CHECK(field_histogram(vec, &Base::value, 0.0, 1.0, 2) == std::vector<size_t>{5, 5});
+}
+TEST_SUITE_END();
@@ -0,0 +1,162 @@
+#ifndef POLYVECTOR_IO_H
+#define POLYVECTOR_IO_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <vector>
+#include "polyvector_registry.h"
+
+// Binary snapshots of a PolyVector. The file holds a header, a column of type
+// ids and the raw slot bytes. Saving writes the slots in one block; loading
+// reads them straight into the vector's storage in one block and then rewrites
+// each vptr from its type id. No element constructor or virtual call runs.
+
+struct PolyFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint64_t count;
+    uint64_t type_offset;
+    uint64_t slot_offset;
+};
+
+constexpr char poly_file_magic[8] = {'P', 'O', 'L', 'Y', 'V', 'E', 'C', '\0'};
+constexpr uint32_t poly_file_version = 1;
+
+// Slots start on a 64-byte boundary so the file can also be mapped
+inline PolyFileHeader make_poly_file_header(uint32_t slot_size, uint64_t count) {
+    PolyFileHeader header {};
+    std::memcpy(header.magic, poly_file_magic, sizeof(header.magic));
+    header.version = poly_file_version;
+    header.slot_size = slot_size;
+    header.count = count;
+    header.type_offset = sizeof(PolyFileHeader);
+    header.slot_offset = (header.type_offset + sizeof(uint32_t) * count + 63) / 64 * 64;
+    return header;
+}
+
+inline bool valid_poly_file_header(const PolyFileHeader& header, uint32_t slot_size) {
+    return std::memcmp(header.magic, poly_file_magic, sizeof(header.magic)) == 0
+        && header.version == poly_file_version
+        && header.slot_size == slot_size;
+}
+
+// Whether both columns the header describes lie within file_size bytes. An
+// empty vector is saved as the header alone. Divides rather than multiplies,
+// so a corrupt count can't overflow.
+inline bool poly_file_fits(const PolyFileHeader& header, uint64_t file_size) {
+    if (header.count == 0) {
+        return true;
+    }
+    return header.type_offset <= file_size
+        && header.count <= (file_size - header.type_offset) / sizeof(uint32_t)
+        && header.slot_offset <= file_size
+        && header.count <= (file_size - header.slot_offset) / header.slot_size;
+}
+
+// Type ids for every element, or an empty optional if any type is unregistered
+template<typename Base, typename Allocator, typename Stats>
+std::optional<std::vector<uint32_t>> type_ids_of(PolyVector<Base, Allocator, Stats>& vec, PolyTypeRegistry<Base>& registry) {
+    std::vector<uint32_t> ids(vec.size());
+    const void* last_vptr = nullptr;
+    uint32_t last_id = 0;
+    for (size_t index = 0; index < vec.size(); ++index) {
+        const void* vptr = vptr_of(vec[index]);
+        if (vptr != last_vptr) {
+            std::optional<uint32_t> id = registry.find_id(vptr);
+            if (!id) {
+                return std::nullopt;
+            }
+            last_vptr = vptr;
+            last_id = *id;
+        }
+        ids[index] = last_id;
+    }
+    return ids;
+}
+
+// Rewrites the vptr of count slots from their type ids. Returns false at the
+// first unregistered id.
+template<typename Base>
+bool restore_vptrs(Base* slots, const uint32_t* ids, size_t count, PolyTypeRegistry<Base>& registry) {
+    const void* vptr = nullptr;
+    uint32_t last_id = 0;
+    for (size_t index = 0; index < count; ++index) {
+        if (vptr == nullptr || ids[index] != last_id) {
+            vptr = registry.find_vptr(ids[index]);
+            if (vptr == nullptr) {
+                return false;
+            }
+            last_id = ids[index];
+        }
+        write_vptr(slots + index, vptr);
+    }
+    return true;
+}
+
+// Returns false if a type is unregistered or the file can't be written
+template<typename Base, typename Allocator, typename Stats>
+bool save(PolyVector<Base, Allocator, Stats>& vec, const char* path, PolyTypeRegistry<Base>& registry) {
+    std::optional<std::vector<uint32_t>> ids = type_ids_of(vec, registry);
+    if (!ids) {
+        return false;
+    }
+
+    std::FILE* file = std::fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    PolyFileHeader header = make_poly_file_header(sizeof(Base), vec.size());
+    const char padding[64] = {};
+    size_t padding_size = header.slot_offset - header.type_offset - sizeof(uint32_t) * ids->size();
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && vec.size() > 0) {
+        ok = std::fwrite(ids->data(), sizeof(uint32_t), ids->size(), file) == ids->size()
+            && std::fwrite(padding, 1, padding_size, file) == padding_size
+            && std::fwrite(static_cast<void*>(vec.data()), sizeof(Base), vec.size(), file) == vec.size();
+    }
+    return std::fclose(file) == 0 && ok;
+}
+
+// Replaces the contents of vec with the file's elements. Returns false, leaving
+// vec empty, if the file is malformed or holds an unregistered type id.
+template<typename Base, typename Allocator, typename Stats>
+bool load(PolyVector<Base, Allocator, Stats>& vec, const char* path, PolyTypeRegistry<Base>& registry) {
+    vec.clear();
+    std::FILE* file = std::fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    // Sized before anything is allocated from the header
+    PolyFileHeader header;
+    bool ok = std::fseek(file, 0, SEEK_END) == 0;
+    long file_size = ok ? std::ftell(file) : -1;
+    ok = file_size >= 0
+        && std::fseek(file, 0, SEEK_SET) == 0
+        && std::fread(&header, sizeof(header), 1, file) == 1
+        && valid_poly_file_header(header, sizeof(Base))
+        && poly_file_fits(header, file_size);
+    std::vector<uint32_t> ids;
+    if (ok) {
+        ids.resize(header.count);
+        ok = std::fseek(file, header.type_offset, SEEK_SET) == 0
+            && std::fread(ids.data(), sizeof(uint32_t), ids.size(), file) == ids.size()
+            && std::fseek(file, header.slot_offset, SEEK_SET) == 0;
+    }
+    if (ok && header.count > 0) {
+        Base* slots = vec.append_uninitialized(header.count);
+        ok = std::fread(static_cast<void*>(slots), sizeof(Base), header.count, file) == header.count
+            && restore_vptrs(slots, ids.data(), ids.size(), registry);
+        if (!ok) {
+            vec.release_elements();
+        }
+    }
+    std::fclose(file);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,214 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "polyvector_io.h"
+
+enum Type {BaseT, DerivedT, UnregisteredT};
+
+class Base {
+public:
+    int data;
+    float weight;
+
+    Base(int data_in, float weight_in) : data{data_in}, weight{weight_in} {};
+    Base() : Base(0, 0) {};
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in, float weight_in) : Base(data_in, weight_in) {};
+    Derived() = default;
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+class Unregistered : public Base {
+public:
+    Unregistered(int data_in, float weight_in) : Base(data_in, weight_in) {};
+    virtual Type get_type() {
+        return UnregisteredT;
+    }
+};
+
+static std::string temp_path(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static void register_types(PolyTypeRegistry<Base>& registry) {
+    registry.add<Base>(1);
+    registry.add<Derived>(2, 0, 0.0f);
+}
+
+TEST_SUITE_BEGIN("Type registry");
+TEST_CASE("add and find") {
+    PolyTypeRegistry<Base> registry;
+    CHECK(registry.add<Base>(1));
+    CHECK(registry.add<Derived>(2));
+    CHECK(registry.add<Derived>(2));
+    CHECK(!registry.add<Derived>(3));
+    CHECK(!registry.add<Unregistered>(1, 0, 0.0f));
+    CHECK(registry.size() == 2);
+
+    Derived derived;
+    CHECK(registry.find_id(vptr_of<Base>(derived)) == 2u);
+    CHECK(registry.find_vptr(2) == vptr_of<Base>(derived));
+    CHECK(registry.find_vptr(7) == nullptr);
+    CHECK(!registry.find_id(nullptr));
+}
+TEST_SUITE_END();
+
+TEST_SUITE_BEGIN("Save and load");
+TEST_CASE("Round trip") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_io_round_trip.bin");
+    {
+        PolyVector<Base> vec;
+        for (int i = 0; i < 1000; ++i) {
+            if (i % 3 == 0) {
+                vec.emplace_back<Base>(i, i * 0.5f);
+            }
+            else {
+                vec.emplace_back<Derived>(i, i * 0.5f);
+            }
+        }
+        CHECK(save(vec, path.c_str(), registry));
+    }
+
+    PolyVector<Base> loaded;
+    loaded.emplace_back<Base>(-1, 0.0f);
+    CHECK(load(loaded, path.c_str(), registry));
+
+    CHECK(loaded.size() == 1000);
+    bool intact = true;
+    for (int i = 0; i < 1000; ++i) {
+        intact &= loaded[i].data == i && loaded[i].weight == i * 0.5f;
+        intact &= loaded[i].get_type() == (i % 3 == 0 ? BaseT : DerivedT);
+    }
+    CHECK(intact);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Load rewrites vptrs") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_io_vptr.bin");
+    {
+        PolyVector<Base> vec;
+        vec.emplace_back<Derived>(5, 1.0f);
+        vec.emplace_back<Base>(6, 2.0f);
+        CHECK(save(vec, path.c_str(), registry));
+    }
+
+    // Scribble over the stored vptrs, as if written by another process
+    PolyFileHeader header;
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        for (uint64_t index = 0; index < header.count; ++index) {
+            file.seekp(header.slot_offset + index * sizeof(Base));
+            const void* garbage = reinterpret_cast<const void*>(0x1234);
+            file.write(reinterpret_cast<const char*>(&garbage), sizeof(garbage));
+        }
+    }
+
+    PolyVector<Base> loaded;
+    CHECK(load(loaded, path.c_str(), registry));
+    CHECK(loaded[0].get_type() == DerivedT);
+    CHECK(loaded[1].get_type() == BaseT);
+    CHECK(loaded[1].data == 6);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Empty round trip") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_io_empty.bin");
+    PolyVector<Base> vec;
+    CHECK(save(vec, path.c_str(), registry));
+
+    PolyVector<Base> loaded;
+    CHECK(load(loaded, path.c_str(), registry));
+    CHECK(loaded.size() == 0);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Unregistered type is not saved") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    PolyVector<Base> vec;
+    vec.emplace_back<Unregistered>(1, 1.0f);
+
+    CHECK(!save(vec, temp_path("polyvector_io_unregistered.bin").c_str(), registry));
+}
+
+TEST_CASE("Load failures") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_io_failure.bin");
+    {
+        PolyVector<Base> vec;
+        vec.emplace_back<Derived>(1, 1.0f);
+        CHECK(save(vec, path.c_str(), registry));
+    }
+
+    PolyVector<Base> loaded;
+    PolyTypeRegistry<Base> partial;
+    partial.add<Base>(1);
+    CHECK(!load(loaded, path.c_str(), partial));
+    CHECK(loaded.size() == 0);
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    CHECK(!load(loaded, path.c_str(), registry));
+    CHECK(loaded.size() == 0);
+
+    CHECK(!load(loaded, temp_path("polyvector_io_missing.bin").c_str(), registry));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Truncated and corrupt files fail to load") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_io_truncated.bin");
+    {
+        PolyVector<Base> vec;
+        for (int i = 0; i < 100; ++i) {
+            vec.emplace_back<Derived>(i, 1.0f);
+        }
+        CHECK(save(vec, path.c_str(), registry));
+    }
+
+    // Cut inside the type ids, so the slots are missing entirely
+    PolyVector<Base> loaded;
+    std::filesystem::resize_file(path, sizeof(PolyFileHeader) + 10 * sizeof(uint32_t));
+    CHECK(!load(loaded, path.c_str(), registry));
+    CHECK(loaded.size() == 0);
+
+    // A count far past the file must not be allocated
+    PolyFileHeader header = make_poly_file_header(sizeof(Base), 1);
+    header.count = uint64_t{1} << 60;
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    REQUIRE(file != nullptr);
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fclose(file);
+    CHECK(!load(loaded, path.c_str(), registry));
+    CHECK(loaded.size() == 0);
+    CHECK(loaded.capacity() == 0);
+
+    std::filesystem::resize_file(path, sizeof(PolyFileHeader) - 1);
+    CHECK(!load(loaded, path.c_str(), registry));
+    std::filesystem::remove(path);
+}
+TEST_SUITE_END();
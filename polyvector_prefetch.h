@@ -0,0 +1,137 @@
+#ifndef POLYVECTOR_PREFETCH_H
+#define POLYVECTOR_PREFETCH_H
+
+#include <algorithm>
+#include "polyvector.h"
+
+// Traversal that prefetches slots a fixed distance ahead, for large slots where
+// each element's work (typically a virtual call) is too short for the hardware
+// prefetcher to stay ahead. Only the first cache line of a slot is prefetched:
+// it holds the vptr, which every virtual call reads. Prefetching whole large
+// slots measured slower, as most calls read only a few of their lines.
+
+// Slots ahead to prefetch when no distance is given: about 4 KiB ahead, so
+// smaller slots use a longer distance, and never fewer than 16 slots. See the
+// prefetch_distance benchmark.
+template<typename Base>
+constexpr size_t default_prefetch_distance = std::max<size_t>(16, 4096 / sizeof(Base));
+
+template<typename Base>
+inline void prefetch_slot(const Base* slot) {
+    __builtin_prefetch(slot);
+}
+
+// Calls f on every element, prefetching the slot distance elements ahead. A
+// distance of 0 turns prefetching off.
+template<typename Base, typename Allocator, typename Stats, typename F>
+void for_each_prefetched(PolyVector<Base, Allocator, Stats>& vec, F&& f, size_t distance = default_prefetch_distance<Base>) {
+    Base* data = vec.data();
+    size_t size = vec.size();
+    if (distance == 0) {
+        for (size_t index = 0; index < size; ++index) {
+            f(data[index]);
+        }
+        return;
+    }
+    size_t ahead = std::min(distance, size);
+    for (size_t index = 0; index < ahead; ++index) {
+        prefetch_slot(data + index);
+    }
+    size_t index = 0;
+    for (; index + distance < size; ++index) {
+        prefetch_slot(data + index + distance);
+        f(data[index]);
+    }
+    for (; index < size; ++index) {
+        f(data[index]);
+    }
+}
+
+// A range over a PolyVector whose iterator prefetches distance slots ahead of
+// itself on every increment
+template<typename Base>
+class PrefetchedRange {
+public:
+    class iterator {
+        public:
+            // Member types
+            using difference_type = std::ptrdiff_t;
+            using value_type = Base;
+            using reference = Base&;
+            using pointer = Base*;
+            using iterator_category = std::forward_iterator_tag;
+
+            // Member functions
+            iterator() : mPtr{nullptr}, mAhead{nullptr}, mLast{nullptr} {};
+            iterator(Base* ptr, Base* ahead, Base* last) : mPtr{ptr}, mAhead{ahead}, mLast{last} {};
+
+            // operators
+            Base& operator*() const {
+                return *mPtr;
+            }
+
+            Base* operator->() const {
+                return mPtr;
+            }
+
+            iterator& operator++() {
+                ++mPtr;
+                if (mAhead < mLast) {
+                    ++mAhead;
+                    prefetch_slot(mAhead);
+                }
+                return *this;
+            }
+
+            iterator operator++(int) {
+                iterator tmp = *this;
+                ++(*this);
+                return tmp;
+            }
+
+            bool operator==(const iterator other) const {
+                return other.mPtr == mPtr;
+            }
+
+            bool operator!=(const iterator other) const {
+                return other.mPtr != mPtr;
+            }
+
+        private:
+            Base* mPtr;
+            Base* mAhead;
+            Base* mLast;
+    };
+
+    PrefetchedRange(Base* data, size_t size, size_t distance) : data_{data}, size_{size}, distance_{distance} {};
+
+    // Prefetches the first slot and the distance slots after it
+    iterator begin() {
+        Base* last = size_ == 0 ? data_ : data_ + size_ - 1;
+        if (distance_ == 0 || size_ == 0) {
+            return iterator(data_, last, last);
+        }
+        size_t ahead = std::min(distance_ + 1, size_);
+        for (size_t index = 0; index < ahead; ++index) {
+            prefetch_slot(data_ + index);
+        }
+        return iterator(data_, data_ + ahead - 1, last);
+    }
+
+    iterator end() {
+        return iterator(data_ + size_, nullptr, nullptr);
+    }
+
+private:
+    Base* data_;
+    size_t size_;
+    size_t distance_;
+};
+
+// for (Base& item : prefetched(vec)) { ... }
+template<typename Base, typename Allocator, typename Stats>
+PrefetchedRange<Base> prefetched(PolyVector<Base, Allocator, Stats>& vec, size_t distance = default_prefetch_distance<Base>) {
+    return PrefetchedRange<Base>(vec.data(), vec.size(), distance);
+}
+
+#endif
@@ -0,0 +1,98 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <vector>
+#include "polyvector_prefetch.h"
+
+enum Type {BaseT, DerivedT};
+
+// Several cache lines per slot
+class Base {
+public:
+    int data;
+    char padding[200];
+
+    Base(int data_in) : data{data_in}, padding{} {};
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+static void fill(PolyVector<Base>& vec, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (i % 2 == 0) {
+            vec.emplace_back<Base>(i);
+        }
+        else {
+            vec.emplace_back<Derived>(i);
+        }
+    }
+}
+
+TEST_SUITE_BEGIN("Prefetch");
+TEST_CASE("Default distance scales with slot size") {
+    CHECK(default_prefetch_distance<Base> == 4096 / sizeof(Base));
+    CHECK(default_prefetch_distance<char[1024]> == 16);
+    CHECK(default_prefetch_distance<int> == 1024);
+}
+
+TEST_CASE("for_each_prefetched visits every element in order") {
+    for (size_t distance : {size_t{0}, size_t{1}, size_t{3}, default_prefetch_distance<Base>, size_t{1000}}) {
+        for (int count : {0, 1, 5, 100}) {
+            PolyVector<Base> vec;
+            fill(vec, count);
+            std::vector<int> seen;
+            int derived = 0;
+            for_each_prefetched(vec, [&](Base& item) {
+                seen.push_back(item.data);
+                derived += item.get_type() == DerivedT;
+            }, distance);
+
+            bool in_order = static_cast<int>(seen.size()) == count;
+            for (int i = 0; in_order && i < count; ++i) {
+                in_order = seen[i] == i;
+            }
+            CHECK(in_order);
+            CHECK(derived == count / 2);
+        }
+    }
+}
+
+TEST_CASE("prefetched range") {
+    for (size_t distance : {size_t{0}, size_t{1}, size_t{4}, size_t{1000}}) {
+        for (int count : {0, 1, 5, 100}) {
+            PolyVector<Base> vec;
+            fill(vec, count);
+            int expected = 0;
+            bool in_order = true;
+            for (Base& item : prefetched(vec, distance)) {
+                in_order &= item.data == expected;
+                ++expected;
+            }
+            CHECK(in_order);
+            CHECK(expected == count);
+        }
+    }
+
+    PolyVector<Base> vec;
+    fill(vec, 10);
+    auto range = prefetched(vec);
+    auto it = range.begin();
+    CHECK(it->data == 0);
+    it++;
+    CHECK((*it).get_type() == DerivedT);
+}
+TEST_SUITE_END();
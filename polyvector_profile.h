@@ -0,0 +1,365 @@
+#ifndef POLYVECTOR_PROFILE_H
+#define POLYVECTOR_PROFILE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "polyvector.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define POLYVECTOR_RDTSC 1
+#else
+#define POLYVECTOR_RDTSC 0
+#endif
+
+#if defined(__GXX_RTTI) || defined(__cpp_rtti)
+#include <cxxabi.h>
+#define POLYVECTOR_RTTI 1
+#else
+#define POLYVECTOR_RTTI 0
+#endif
+
+// Profiling of the dynamic types in a PolyVector, for deciding whether sorting
+// or partitioning by type would pay off in a traversal.
+
+// Demangled name of item's dynamic type, or an empty string without RTTI
+template<typename Base>
+std::string dynamic_type_name(Base& item) {
+#if POLYVECTOR_RTTI
+    const char* mangled = typeid(item).name();
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+    std::string name = status == 0 ? demangled : mangled;
+    std::free(demangled);
+    return name;
+#else
+    (void)item;
+    return "";
+#endif
+}
+
+struct TypeCensusEntry {
+    const void* vptr;
+    std::string name;
+    size_t count;
+    double fraction;
+};
+
+struct TypeCensus {
+    // Most common first. Counts are of sampled elements.
+    std::vector<TypeCensusEntry> types;
+    size_t size;
+    size_t sampled;
+    // Mean length of a run of one type in storage order
+    double average_run_length;
+    // Entropy of the dynamic type of one element, in bits
+    double type_entropy_bits;
+    // Entropy of an element's type given the previous element's type, in
+    // bits: roughly what an indirect branch predictor keyed on the last
+    // target is left to guess per call in a traversal
+    double transition_entropy_bits;
+};
+
+// Counts dynamic types over every stride-th element, along with the type of
+// the element after each one. The pairs give the run length and transition
+// entropy without visiting everything, so a large stride is cheap enough to
+// sample in production. With a stride of 1 every figure is exact.
+template<typename Base, typename Allocator, typename Stats>
+requires std::is_polymorphic_v<Base>
+TypeCensus type_census(PolyVector<Base, Allocator, Stats>& vec, size_t stride = 1) {
+    stride = std::max<size_t>(stride, 1);
+    Base* data = vec.data();
+    size_t size = vec.size();
+
+    std::vector<TypeCensusEntry> types;
+    std::unordered_map<const void*, size_t> type_of;
+    const void* last_vptr = nullptr;
+    size_t last_type = 0;
+    auto lookup = [&](size_t index) {
+        const void* vptr = vptr_of(data[index]);
+        if (vptr != last_vptr) {
+            auto [entry, inserted] = type_of.try_emplace(vptr, types.size());
+            if (inserted) {
+                types.push_back({vptr, dynamic_type_name(data[index]), 0, 0});
+            }
+            last_vptr = vptr;
+            last_type = entry->second;
+        }
+        return last_type;
+    };
+
+    size_t sampled = 0;
+    size_t pairs = 0;
+    size_t changes = 0;
+    std::map<std::pair<size_t, size_t>, size_t> transitions;
+    for (size_t index = 0; index < size; index += stride) {
+        size_t type = lookup(index);
+        ++types[type].count;
+        ++sampled;
+        if (index + 1 < size) {
+            size_t next = lookup(index + 1);
+            ++pairs;
+            changes += next != type;
+            ++transitions[{type, next}];
+        }
+    }
+
+    TypeCensus census {{}, size, sampled, 0, 0, 0};
+    if (sampled == 0) {
+        return census;
+    }
+
+    for (TypeCensusEntry& entry : types) {
+        entry.fraction = static_cast<double>(entry.count) / sampled;
+        census.type_entropy_bits -= entry.fraction * std::log2(entry.fraction);
+    }
+
+    // Runs are one more than the changes between neighbours
+    double runs = 1;
+    if (pairs > 0) {
+        runs += static_cast<double>(changes) / pairs * (size - 1);
+    }
+    census.average_run_length = size / runs;
+
+    std::vector<size_t> leaving(types.size(), 0);
+    for (auto& [pair, count] : transitions) {
+        leaving[pair.first] += count;
+    }
+    for (auto& [pair, count] : transitions) {
+        census.transition_entropy_bits += static_cast<double>(count) / pairs
+                                          * std::log2(static_cast<double>(leaving[pair.first]) / count);
+    }
+
+    std::stable_sort(types.begin(), types.end(), [](const TypeCensusEntry& a, const TypeCensusEntry& b) {
+        return a.count > b.count;
+    });
+    census.types = std::move(types);
+    return census;
+}
+
+// Timestamps for sampled calls: the time stamp counter where there is one,
+// otherwise steady_clock nanoseconds
+inline uint64_t profile_ticks() {
+#if POLYVECTOR_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct ProfileClock {
+    double ns_per_tick;
+    // Ticks between two back-to-back reads, taken off every sample
+    uint64_t overhead_ticks;
+};
+
+// Measured once, against steady_clock over about 2 ms, on first use
+inline const ProfileClock& profile_clock() {
+    static const ProfileClock clock = [] {
+        using steady = std::chrono::steady_clock;
+        steady::time_point start = steady::now();
+        uint64_t first = profile_ticks();
+        steady::time_point end = start;
+        while (end - start < std::chrono::milliseconds(2)) {
+            end = steady::now();
+        }
+        uint64_t ticks = std::max<uint64_t>(profile_ticks() - first, 1);
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+        uint64_t overhead = UINT64_MAX;
+        for (int run = 0; run < 64; ++run) {
+            uint64_t before = profile_ticks();
+            overhead = std::min(overhead, profile_ticks() - before);
+        }
+        return ProfileClock{ns / ticks, overhead};
+    }();
+    return clock;
+}
+
+struct DispatchSample {
+    // Position in the traversal that took it
+    size_t index;
+    double ns;
+};
+
+// Calls made on one dynamic type, of which sampled were timed
+struct DispatchProfileEntry {
+    const void* vptr;
+    std::string name;
+    size_t calls;
+    size_t sampled;
+    double sampled_ns;
+    double max_ns;
+    // The slowest samples, slowest first
+    std::vector<DispatchSample> slowest;
+
+    double mean_ns() const {
+        return sampled == 0 ? 0 : sampled_ns / sampled;
+    }
+
+    // Time spent in all calls, scaled up from the samples
+    double estimated_ns() const {
+        return mean_ns() * calls;
+    }
+};
+
+// Per-type call times from every profiled_for_each that reports to it.
+// instance() is the process-wide profile, read from any thread.
+class PolyVectorDispatchProfile {
+public:
+    static constexpr size_t slowest_kept = 4;
+
+    static PolyVectorDispatchProfile& instance() {
+        static PolyVectorDispatchProfile profile;
+        return profile;
+    }
+
+    void merge(const std::vector<DispatchProfileEntry>& entries);
+    // Most estimated time first
+    std::vector<DispatchProfileEntry> entries();
+    void dump(std::FILE* out, size_t count = 10);
+    void clear();
+
+    // Adds sample to the slowest of entry
+    static void keep_if_slow(DispatchProfileEntry& entry, DispatchSample sample);
+
+private:
+    std::mutex mutex_;
+    std::vector<DispatchProfileEntry> entries_;
+};
+
+inline void PolyVectorDispatchProfile::keep_if_slow(DispatchProfileEntry& entry, DispatchSample sample) {
+    std::vector<DispatchSample>& slowest = entry.slowest;
+    if (slowest.size() == slowest_kept && sample.ns <= slowest.back().ns) {
+        return;
+    }
+    auto position = std::find_if(slowest.begin(), slowest.end(),
+                                 [&](const DispatchSample& kept) { return sample.ns > kept.ns; });
+    slowest.insert(position, sample);
+    if (slowest.size() > slowest_kept) {
+        slowest.pop_back();
+    }
+}
+
+inline void PolyVectorDispatchProfile::merge(const std::vector<DispatchProfileEntry>& entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const DispatchProfileEntry& entry : entries) {
+        auto existing = std::find_if(entries_.begin(), entries_.end(),
+                                     [&](const DispatchProfileEntry& kept) { return kept.vptr == entry.vptr; });
+        if (existing == entries_.end()) {
+            entries_.push_back(entry);
+            continue;
+        }
+        existing->calls += entry.calls;
+        existing->sampled += entry.sampled;
+        existing->sampled_ns += entry.sampled_ns;
+        existing->max_ns = std::max(existing->max_ns, entry.max_ns);
+        for (const DispatchSample& sample : entry.slowest) {
+            keep_if_slow(*existing, sample);
+        }
+    }
+}
+
+inline std::vector<DispatchProfileEntry> PolyVectorDispatchProfile::entries() {
+    std::vector<DispatchProfileEntry> sorted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sorted = entries_;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const DispatchProfileEntry& a, const DispatchProfileEntry& b) {
+        return a.estimated_ns() > b.estimated_ns();
+    });
+    return sorted;
+}
+
+inline void PolyVectorDispatchProfile::dump(std::FILE* out, size_t count) {
+    std::vector<DispatchProfileEntry> sorted = entries();
+    std::fprintf(out, "%14s %12s %10s %10s %10s  %s\n", "estimated_ns", "calls", "sampled", "mean_ns", "max_ns", "type");
+    for (size_t index = 0; index < std::min(count, sorted.size()); ++index) {
+        DispatchProfileEntry& entry = sorted[index];
+        std::fprintf(out, "%14.0f %12zu %10zu %10.1f %10.1f  %s\n", entry.estimated_ns(), entry.calls,
+                     entry.sampled, entry.mean_ns(), entry.max_ns, entry.name.empty() ? "?" : entry.name.c_str());
+    }
+}
+
+inline void PolyVectorDispatchProfile::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+// Calls f on every element in order and times about one call in every rate,
+// attributing it to the element's dynamic type. Gaps between samples vary
+// randomly around rate, so a repeating type pattern can't hide from them.
+// Every call is counted; the times and slowest samples go to profile when
+// the traversal ends.
+template<typename Base, typename Allocator, typename Stats, typename F>
+requires std::is_polymorphic_v<Base>
+void profiled_for_each(PolyVector<Base, Allocator, Stats>& vec, F&& f, size_t rate = 64,
+                       PolyVectorDispatchProfile& profile = PolyVectorDispatchProfile::instance()) {
+    const ProfileClock& clock = profile_clock();
+    Base* data = vec.data();
+    size_t size = vec.size();
+
+    // Types are few, so a short linear search beats hashing
+    std::vector<DispatchProfileEntry> entries;
+    const void* last_vptr = nullptr;
+    size_t last_type = 0;
+
+    uint64_t random = 0x9e3779b97f4a7c15;
+    auto gap = [&]() -> size_t {
+        if (rate <= 1) {
+            return 1;
+        }
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        return 1 + random % (2 * rate - 1);
+    };
+
+    size_t next_sample = gap() - 1;
+    for (size_t index = 0; index < size; ++index) {
+        const void* vptr = vptr_of(data[index]);
+        if (vptr != last_vptr) {
+            last_type = 0;
+            while (last_type < entries.size() && entries[last_type].vptr != vptr) {
+                ++last_type;
+            }
+            if (last_type == entries.size()) {
+                entries.push_back({vptr, dynamic_type_name(data[index]), 0, 0, 0, 0, {}});
+            }
+            last_vptr = vptr;
+        }
+        DispatchProfileEntry& entry = entries[last_type];
+        ++entry.calls;
+
+        if (index != next_sample) {
+            f(data[index]);
+            continue;
+        }
+        uint64_t start = profile_ticks();
+        f(data[index]);
+        uint64_t ticks = profile_ticks() - start;
+        double ns = (ticks > clock.overhead_ticks ? ticks - clock.overhead_ticks : 0) * clock.ns_per_tick;
+        ++entry.sampled;
+        entry.sampled_ns += ns;
+        entry.max_ns = std::max(entry.max_ns, ns);
+        PolyVectorDispatchProfile::keep_if_slow(entry, {index, ns});
+        next_sample += gap();
+    }
+    profile.merge(entries);
+}
+
+#endif
@@ -0,0 +1,267 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <cstdio>
+#include <cstring>
+#include "polyvector_algorithm.h"
+#include "polyvector_profile.h"
+
+enum Type {BaseT, DerivedT, OtherT};
+
+class Base {
+public:
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+    virtual ~Base() = default;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+class Other : public Base {
+public:
+    Other(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return OtherT;
+    }
+};
+
+TEST_SUITE_BEGIN("Type census");
+TEST_CASE("Empty vector") {
+    PolyVector<Base> vec;
+    TypeCensus census = type_census(vec);
+    CHECK(census.types.empty());
+    CHECK(census.sampled == 0);
+    CHECK(census.average_run_length == 0);
+}
+
+TEST_CASE("Counts types, most common first") {
+    PolyVector<Base> vec;
+    for (int i = 0; i < 10; ++i) {
+        if (i < 2) {
+            vec.emplace_back<Base>(i);
+        }
+        else if (i < 5) {
+            vec.emplace_back<Other>(i);
+        }
+        else {
+            vec.emplace_back<Derived>(i);
+        }
+    }
+
+    TypeCensus census = type_census(vec);
+    REQUIRE(census.types.size() == 3);
+    CHECK(census.sampled == 10);
+    CHECK(census.types[0].count == 5);
+    CHECK(census.types[0].vptr == vptr_of(vec[9]));
+    CHECK(census.types[0].fraction == doctest::Approx(0.5));
+    CHECK(census.types[1].count == 3);
+    CHECK(census.types[2].count == 2);
+#if POLYVECTOR_RTTI
+    CHECK(census.types[0].name == "Derived");
+    CHECK(census.types[1].name == "Other");
+    CHECK(census.types[2].name == "Base");
+#endif
+
+    // Three runs, each predictable once entered
+    CHECK(census.average_run_length == doctest::Approx(10.0 / 3));
+    double expected = -(0.5 * std::log2(0.5) + 0.3 * std::log2(0.3) + 0.2 * std::log2(0.2));
+    CHECK(census.type_entropy_bits == doctest::Approx(expected));
+    CHECK(census.transition_entropy_bits < census.type_entropy_bits);
+}
+
+TEST_CASE("Alternating types are one bit of entropy with no runs") {
+    PolyVector<Base> vec;
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 2 == 0) {
+            vec.emplace_back<Base>(i);
+        }
+        else {
+            vec.emplace_back<Derived>(i);
+        }
+    }
+    TypeCensus census = type_census(vec);
+    CHECK(census.average_run_length == doctest::Approx(1));
+    CHECK(census.type_entropy_bits == doctest::Approx(1));
+    // The next type is always the other one
+    CHECK(census.transition_entropy_bits == doctest::Approx(0));
+}
+
+TEST_CASE("Sorting by type lengthens runs") {
+    PolyVector<Base> vec;
+    uint32_t state = 1;
+    for (int i = 0; i < 3000; ++i) {
+        state = state * 1664525 + 1013904223;
+        switch (state >> 30) {
+            case 0: vec.emplace_back<Base>(i); break;
+            case 1: vec.emplace_back<Derived>(i); break;
+            default: vec.emplace_back<Other>(i); break;
+        }
+    }
+    TypeCensus before = type_census(vec);
+    CHECK(before.average_run_length < 3);
+    CHECK(before.transition_entropy_bits > 1);
+
+    sort_by_type(vec);
+    TypeCensus after = type_census(vec);
+    CHECK(after.average_run_length == doctest::Approx(1000).epsilon(0.2));
+    CHECK(after.transition_entropy_bits < 0.01);
+    CHECK(after.type_entropy_bits == doctest::Approx(before.type_entropy_bits));
+}
+
+TEST_CASE("Strided sampling estimates the whole") {
+    PolyVector<Base> vec;
+    for (int i = 0; i < 10000; ++i) {
+        if ((i / 50) % 2 == 0) {
+            vec.emplace_back<Base>(i);
+        }
+        else {
+            vec.emplace_back<Derived>(i);
+        }
+    }
+    TypeCensus exact = type_census(vec);
+    TypeCensus sampled = type_census(vec, 7);
+    CHECK(exact.average_run_length == doctest::Approx(50));
+    CHECK(sampled.sampled == (10000 + 6) / 7);
+    CHECK(sampled.average_run_length == doctest::Approx(50).epsilon(0.3));
+    CHECK(sampled.types[0].fraction == doctest::Approx(0.5).epsilon(0.05));
+
+    CHECK(type_census(vec, 0).sampled == 10000);
+}
+TEST_SUITE_END();
+
+// Calls on Other are made slow by the callback, not the class
+static void spin_on_other(Base& item) {
+    if (item.get_type() == OtherT) {
+        volatile int sink = 0;
+        for (int i = 0; i < 20000; ++i) {
+            sink = sink + i;
+        }
+    }
+}
+
+TEST_SUITE_BEGIN("Dispatch profile");
+TEST_CASE("Every element is visited in order and counted by type") {
+    PolyVector<Base> vec;
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 4 == 0) {
+            vec.emplace_back<Derived>(i);
+        }
+        else {
+            vec.emplace_back<Base>(i);
+        }
+    }
+    PolyVectorDispatchProfile profile;
+    int expected = 0;
+    profiled_for_each(vec, [&](Base& item) { CHECK(item.data == expected++); }, 16, profile);
+    CHECK(expected == 1000);
+
+    std::vector<DispatchProfileEntry> entries = profile.entries();
+    REQUIRE(entries.size() == 2);
+    size_t calls = 0;
+    size_t sampled = 0;
+    for (DispatchProfileEntry& entry : entries) {
+        calls += entry.calls;
+        sampled += entry.sampled;
+        CHECK(entry.sampled <= entry.calls);
+        CHECK(entry.slowest.size() <= PolyVectorDispatchProfile::slowest_kept);
+        if (entry.vptr == vptr_of(vec[0])) {
+            CHECK(entry.calls == 250);
+        }
+    }
+    CHECK(calls == 1000);
+    // About one in 16, with random gaps
+    CHECK(sampled > 1000 / 32);
+    CHECK(sampled < 1000 / 8);
+}
+
+TEST_CASE("Random gaps sample every type of a repeating pattern") {
+    PolyVector<Base> vec;
+    for (int i = 0; i < 4000; ++i) {
+        if (i % 2 == 0) {
+            vec.emplace_back<Base>(i);
+        }
+        else {
+            vec.emplace_back<Derived>(i);
+        }
+    }
+    PolyVectorDispatchProfile profile;
+    profiled_for_each(vec, [](Base&) {}, 2, profile);
+    for (DispatchProfileEntry& entry : profile.entries()) {
+        CHECK(entry.sampled > 500);
+    }
+}
+
+TEST_CASE("Slow types rank first, with their slowest calls") {
+    PolyVector<Base> vec;
+    for (int i = 0; i < 200; ++i) {
+        if (i % 10 == 3) {
+            vec.emplace_back<Other>(i);
+        }
+        else {
+            vec.emplace_back<Derived>(i);
+        }
+    }
+    PolyVectorDispatchProfile profile;
+    profiled_for_each(vec, spin_on_other, 1, profile);
+    profiled_for_each(vec, spin_on_other, 1, profile);
+
+    std::vector<DispatchProfileEntry> entries = profile.entries();
+    REQUIRE(entries.size() == 2);
+    DispatchProfileEntry& slow = entries[0];
+    CHECK(slow.vptr == vptr_of(vec[3]));
+    CHECK(slow.calls == 40);
+    CHECK(slow.sampled == 40);
+    CHECK(slow.mean_ns() > entries[1].mean_ns());
+    CHECK(slow.max_ns >= slow.mean_ns());
+    CHECK(slow.estimated_ns() == doctest::Approx(slow.sampled_ns));
+#if POLYVECTOR_RTTI
+    CHECK(slow.name == "Other");
+#endif
+
+    REQUIRE(slow.slowest.size() == PolyVectorDispatchProfile::slowest_kept);
+    CHECK(slow.slowest[0].ns == slow.max_ns);
+    for (size_t i = 0; i < slow.slowest.size(); ++i) {
+        CHECK(slow.slowest[i].index % 10 == 3);
+        if (i > 0) {
+            CHECK(slow.slowest[i].ns <= slow.slowest[i - 1].ns);
+        }
+    }
+
+    std::FILE* out = std::tmpfile();
+    profile.dump(out);
+    std::rewind(out);
+    char text[4096] = {};
+    std::fread(text, 1, sizeof(text) - 1, out);
+    std::fclose(out);
+    CHECK(std::strstr(text, "estimated_ns") != nullptr);
+#if POLYVECTOR_RTTI
+    CHECK(std::strstr(text, "Other") != nullptr);
+#endif
+
+    profile.clear();
+    CHECK(profile.entries().empty());
+}
+
+TEST_CASE("Reports to the process-wide profile by default") {
+    PolyVectorDispatchProfile& profile = PolyVectorDispatchProfile::instance();
+    profile.clear();
+    PolyVector<Base> vec;
+    for (int i = 0; i < 100; ++i) {
+        vec.emplace_back<Derived>(i);
+    }
+    profiled_for_each(vec, [](Base&) {});
+    REQUIRE(profile.entries().size() == 1);
+    CHECK(profile.entries()[0].calls == 100);
+    profile.clear();
+}
+TEST_SUITE_END();
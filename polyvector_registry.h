@@ -0,0 +1,84 @@
+#ifndef POLYVECTOR_REGISTRY_H
+#define POLYVECTOR_REGISTRY_H
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include "polyvector.h"
+
+// Maps stable type ids to the vtable pointers of this process, so slots written
+// by one process can be made callable in another by rewriting their vptr.
+// Registering a type declares it trivially serializable: apart from the vptr,
+// its slot bytes must mean the same thing in any process, so no pointers or
+// handles. The vptr is assumed to sit at the front of the slot, as it does on
+// the Itanium and MSVC ABIs for classes without virtual bases.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+class PolyTypeRegistry {
+public:
+    // Registers Derived under id. A prototype is constructed from args to read
+    // its vptr and then destroyed. Returns false if the id or the type is
+    // already registered under a different mapping.
+    template<typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base>
+    bool add(uint32_t id, Args&&... args);
+
+    std::optional<uint32_t> find_id(const void* vptr);
+    const void* find_vptr(uint32_t id);
+    size_t size();
+
+private:
+    std::unordered_map<uint32_t, const void*> vptrs_;
+    std::unordered_map<const void*, uint32_t> ids_;
+};
+
+// Makes a slot callable as the type whose vptr is given
+inline void write_vptr(void* slot, const void* vptr) {
+    std::memcpy(slot, &vptr, sizeof(vptr));
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base>
+bool PolyTypeRegistry<Base>::add(uint32_t id, Args&&... args) {
+    alignas(Derived) unsigned char prototype[sizeof(Derived)];
+    Derived* item = new (prototype) Derived(std::forward<Args>(args)...);
+    const void* vptr = vptr_of<Base>(*item);
+    item->~Derived();
+
+    auto known_vptr = vptrs_.find(id);
+    auto known_id = ids_.find(vptr);
+    if (known_vptr != vptrs_.end() || known_id != ids_.end()) {
+        return known_vptr != vptrs_.end() && known_vptr->second == vptr
+            && known_id != ids_.end() && known_id->second == id;
+    }
+    vptrs_.emplace(id, vptr);
+    ids_.emplace(vptr, id);
+    return true;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+std::optional<uint32_t> PolyTypeRegistry<Base>::find_id(const void* vptr) {
+    auto found = ids_.find(vptr);
+    if (found == ids_.end()) {
+        return std::nullopt;
+    }
+    return found->second;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+const void* PolyTypeRegistry<Base>::find_vptr(uint32_t id) {
+    auto found = vptrs_.find(id);
+    return found == vptrs_.end() ? nullptr : found->second;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+size_t PolyTypeRegistry<Base>::size() {
+    return vptrs_.size();
+}
+
+#endif
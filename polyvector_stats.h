@@ -0,0 +1,351 @@
+#ifndef POLYVECTOR_STATS_H
+#define POLYVECTOR_STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "polyvector.h"
+
+// Opt-in instrumentation for PolyVector:
+//   PolyVector<Base, std::allocator<Base>, PolyVectorStats> vec;
+//   vec.stats().set_name("orders");
+//   PolyVectorCounters mine = vec.stats().counters();
+//   PolyVectorCounters all = PolyVectorStatsRegistry::instance().totals();
+//   PolyVectorGrowthTrace::instance().enable(true);
+//   ...
+//   PolyVectorGrowthTrace::instance().dump(stderr);
+
+// What an instrumented PolyVector has done since it was constructed
+struct PolyVectorCounters {
+    size_t allocations {0};
+    size_t reallocations {0};
+    size_t relocated_bytes {0};
+    size_t inserts {0};
+    size_t erases {0};
+    size_t moved_bytes {0};
+    size_t peak_size {0};
+    size_t peak_capacity {0};
+    size_t destroyed {0};
+
+    // Sums the counts and keeps the larger peaks
+    PolyVectorCounters& operator+=(const PolyVectorCounters& other) {
+        allocations += other.allocations;
+        reallocations += other.reallocations;
+        relocated_bytes += other.relocated_bytes;
+        inserts += other.inserts;
+        erases += other.erases;
+        moved_bytes += other.moved_bytes;
+        peak_size = std::max(peak_size, other.peak_size);
+        peak_capacity = std::max(peak_capacity, other.peak_capacity);
+        destroyed += other.destroyed;
+        return *this;
+    }
+};
+
+// One reallocation, with the call that caused it
+struct PolyVectorGrowthEvent {
+    const char* name;
+    const char* file;
+    const char* function;
+    uint32_t line;
+    size_t old_capacity;
+    size_t new_capacity;
+    size_t copied_bytes;
+};
+
+// Reallocations summed over one call site
+struct PolyVectorGrowthSite {
+    const char* file;
+    const char* function;
+    uint32_t line;
+    size_t reallocations;
+    size_t copied_bytes;
+    size_t largest_capacity;
+};
+
+// The latest reallocations of every PolyVectorStats vector, recorded while
+// enabled into a ring that keeps the last ring_capacity of them. Call sites
+// come from the std::source_location that push_back, emplace_back_at, insert,
+// reserve and append_uninitialized take by default.
+class PolyVectorGrowthTrace {
+public:
+    static constexpr size_t ring_capacity = 4096;
+
+    static PolyVectorGrowthTrace& instance() {
+        static PolyVectorGrowthTrace trace;
+        return trace;
+    }
+
+    void enable(bool on) {
+        enabled_.store(on, std::memory_order_relaxed);
+    }
+
+    bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void record(const PolyVectorGrowthEvent& event);
+    // Oldest first
+    std::vector<PolyVectorGrowthEvent> events();
+    // Reallocations ever recorded, including those the ring has dropped
+    size_t recorded();
+    // The count sites in the ring that copied the most bytes, most first
+    std::vector<PolyVectorGrowthSite> top(size_t count);
+    void dump(std::FILE* out, size_t count = 10);
+    void clear();
+
+private:
+    std::atomic<bool> enabled_ {false};
+    std::mutex mutex_;
+    std::vector<PolyVectorGrowthEvent> ring_;
+    size_t recorded_ {0};
+};
+
+class PolyVectorStats;
+
+// Every live PolyVectorStats in the process, and the totals of those already
+// destroyed, for a scraper to read from any thread
+class PolyVectorStatsRegistry {
+public:
+    static PolyVectorStatsRegistry& instance() {
+        static PolyVectorStatsRegistry registry;
+        return registry;
+    }
+
+    // Live instances and every destroyed one
+    PolyVectorCounters totals();
+    // Name and counters of each live instance
+    std::vector<std::pair<std::string, PolyVectorCounters>> instances();
+    size_t size();
+
+private:
+    friend class PolyVectorStats;
+
+    std::mutex mutex_;
+    std::vector<PolyVectorStats*> live_;
+    PolyVectorCounters retired_;
+
+    void add(PolyVectorStats* stats);
+    void remove(PolyVectorStats* stats);
+};
+
+// Stats policy that counts. Only the thread using the PolyVector writes the
+// counters, with relaxed loads and stores rather than read-modify-writes, so
+// recording costs a few plain instructions while other threads may still read
+// them. Construction and destruction take the registry lock.
+class PolyVectorStats {
+public:
+    PolyVectorStats() {
+        PolyVectorStatsRegistry::instance().add(this);
+    }
+
+    PolyVectorStats(PolyVectorStats& other) = delete;
+    void operator=(PolyVectorStats& other) = delete;
+
+    PolyVectorStats(PolyVectorStats&& other) = delete;
+    void operator=(PolyVectorStats&& other) = delete;
+
+    ~PolyVectorStats() {
+        PolyVectorStatsRegistry::instance().remove(this);
+    }
+
+    // name must outlive the PolyVector, as a string literal does
+    void set_name(const char* name) {
+        name_.store(name, std::memory_order_relaxed);
+    }
+
+    const char* name() {
+        return name_.load(std::memory_order_relaxed);
+    }
+
+    PolyVectorCounters counters() {
+        PolyVectorCounters current;
+        current.allocations = allocations_.load(std::memory_order_relaxed);
+        current.reallocations = reallocations_.load(std::memory_order_relaxed);
+        current.relocated_bytes = relocated_bytes_.load(std::memory_order_relaxed);
+        current.inserts = inserts_.load(std::memory_order_relaxed);
+        current.erases = erases_.load(std::memory_order_relaxed);
+        current.moved_bytes = moved_bytes_.load(std::memory_order_relaxed);
+        current.peak_size = peak_size_.load(std::memory_order_relaxed);
+        current.peak_capacity = peak_capacity_.load(std::memory_order_relaxed);
+        current.destroyed = destroyed_.load(std::memory_order_relaxed);
+        return current;
+    }
+
+    // Hooks called by PolyVector
+
+    void on_allocate(size_t) {
+        add(allocations_, 1);
+    }
+
+    void on_reallocate(size_t bytes) {
+        add(reallocations_, 1);
+        add(relocated_bytes_, bytes);
+    }
+
+    void on_insert(size_t moved_bytes) {
+        add(inserts_, 1);
+        add(moved_bytes_, moved_bytes);
+    }
+
+    void on_erase(size_t moved_bytes) {
+        add(erases_, 1);
+        add(moved_bytes_, moved_bytes);
+    }
+
+    void on_resize(size_t size, size_t capacity) {
+        raise(peak_size_, size);
+        raise(peak_capacity_, capacity);
+    }
+
+    void on_destroy(size_t count) {
+        add(destroyed_, count);
+    }
+
+    void on_grow(const std::source_location& location, size_t old_capacity, size_t new_capacity, size_t copied_bytes) {
+        PolyVectorGrowthTrace& trace = PolyVectorGrowthTrace::instance();
+        if (trace.enabled()) {
+            trace.record({name(), location.file_name(), location.function_name(), location.line(),
+                          old_capacity, new_capacity, copied_bytes});
+        }
+    }
+
+private:
+    std::atomic<const char*> name_ {""};
+    std::atomic<size_t> allocations_ {0};
+    std::atomic<size_t> reallocations_ {0};
+    std::atomic<size_t> relocated_bytes_ {0};
+    std::atomic<size_t> inserts_ {0};
+    std::atomic<size_t> erases_ {0};
+    std::atomic<size_t> moved_bytes_ {0};
+    std::atomic<size_t> peak_size_ {0};
+    std::atomic<size_t> peak_capacity_ {0};
+    std::atomic<size_t> destroyed_ {0};
+
+    static void add(std::atomic<size_t>& counter, size_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    static void raise(std::atomic<size_t>& peak, size_t value) {
+        if (value > peak.load(std::memory_order_relaxed)) {
+            peak.store(value, std::memory_order_relaxed);
+        }
+    }
+};
+
+// PolyVectorStatsRegistry
+
+inline PolyVectorCounters PolyVectorStatsRegistry::totals() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PolyVectorCounters total = retired_;
+    for (PolyVectorStats* stats : live_) {
+        total += stats->counters();
+    }
+    return total;
+}
+
+inline std::vector<std::pair<std::string, PolyVectorCounters>> PolyVectorStatsRegistry::instances() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::pair<std::string, PolyVectorCounters>> result;
+    for (PolyVectorStats* stats : live_) {
+        result.emplace_back(stats->name(), stats->counters());
+    }
+    return result;
+}
+
+inline size_t PolyVectorStatsRegistry::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return live_.size();
+}
+
+inline void PolyVectorStatsRegistry::add(PolyVectorStats* stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    live_.push_back(stats);
+}
+
+inline void PolyVectorStatsRegistry::remove(PolyVectorStats* stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_ += stats->counters();
+    live_.erase(std::find(live_.begin(), live_.end(), stats));
+}
+
+// PolyVectorGrowthTrace
+
+inline void PolyVectorGrowthTrace::record(const PolyVectorGrowthEvent& event) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ring_.size() < ring_capacity) {
+        ring_.push_back(event);
+    }
+    else {
+        ring_[recorded_ % ring_capacity] = event;
+    }
+    ++recorded_;
+}
+
+inline std::vector<PolyVectorGrowthEvent> PolyVectorGrowthTrace::events() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ring_.size() < ring_capacity) {
+        return ring_;
+    }
+    size_t oldest = recorded_ % ring_capacity;
+    std::vector<PolyVectorGrowthEvent> ordered(ring_.begin() + oldest, ring_.end());
+    ordered.insert(ordered.end(), ring_.begin(), ring_.begin() + oldest);
+    return ordered;
+}
+
+inline size_t PolyVectorGrowthTrace::recorded() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return recorded_;
+}
+
+inline std::vector<PolyVectorGrowthSite> PolyVectorGrowthTrace::top(size_t count) {
+    std::map<std::tuple<std::string, uint32_t, std::string>, PolyVectorGrowthSite> sites;
+    for (PolyVectorGrowthEvent& event : events()) {
+        auto [entry, inserted] = sites.try_emplace({event.file, event.line, event.function},
+                                                   PolyVectorGrowthSite{event.file, event.function, event.line, 0, 0, 0});
+        PolyVectorGrowthSite& site = entry->second;
+        ++site.reallocations;
+        site.copied_bytes += event.copied_bytes;
+        site.largest_capacity = std::max(site.largest_capacity, event.new_capacity);
+    }
+
+    std::vector<PolyVectorGrowthSite> sorted;
+    for (auto& [key, site] : sites) {
+        sorted.push_back(site);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const PolyVectorGrowthSite& a, const PolyVectorGrowthSite& b) {
+        return a.copied_bytes != b.copied_bytes ? a.copied_bytes > b.copied_bytes : a.reallocations > b.reallocations;
+    });
+    if (sorted.size() > count) {
+        sorted.resize(count);
+    }
+    return sorted;
+}
+
+inline void PolyVectorGrowthTrace::dump(std::FILE* out, size_t count) {
+    size_t total = recorded();
+    std::fprintf(out, "PolyVector growth: %zu reallocations recorded, last %zu kept\n",
+                 total, std::min(total, ring_capacity));
+    std::fprintf(out, "%14s %14s %14s  %s\n", "copied_bytes", "reallocations", "max_capacity", "call site");
+    for (PolyVectorGrowthSite& site : top(count)) {
+        std::fprintf(out, "%14zu %14zu %14zu  %s:%u %s\n", site.copied_bytes, site.reallocations,
+                     site.largest_capacity, site.file, static_cast<unsigned>(site.line), site.function);
+    }
+}
+
+inline void PolyVectorGrowthTrace::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ring_.clear();
+    recorded_ = 0;
+}
+
+#endif
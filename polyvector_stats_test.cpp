@@ -0,0 +1,276 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include "polyvector_algorithm.h"
+#include "polyvector_stats.h"
+
+enum Type {BaseT, DerivedT};
+
+class Base {
+public:
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+    virtual ~Base() = default;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+
+    bool operator==(const Base& other) const {
+        return data == other.data;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+using StatsVector = PolyVector<Base, std::allocator<Base>, PolyVectorStats>;
+
+TEST_SUITE_BEGIN("PolyVectorStats");
+TEST_CASE("Stats cost nothing when off") {
+    CHECK(sizeof(PolyVector<Base>) == sizeof(Base*) + 2 * sizeof(size_t));
+}
+
+TEST_CASE("Growth counts allocations and relocated bytes") {
+    StatsVector vec;
+    for (int i = 0; i < 5; ++i) {
+        vec.emplace_back<Derived>(i);
+    }
+    // Capacities 1, 2, 4, 8, relocating 1, 2 and 4 elements
+    PolyVectorCounters counters = vec.stats().counters();
+    CHECK(counters.allocations == 4);
+    CHECK(counters.reallocations == 3);
+    CHECK(counters.relocated_bytes == 7 * sizeof(Base));
+    CHECK(counters.peak_size == 5);
+    CHECK(counters.peak_capacity == 8);
+
+    vec.reserve(100);
+    counters = vec.stats().counters();
+    CHECK(counters.allocations == 5);
+    CHECK(counters.relocated_bytes == 12 * sizeof(Base));
+    CHECK(counters.peak_capacity == 100);
+}
+
+TEST_CASE("Insert and erase_value count moved bytes") {
+    StatsVector vec;
+    vec.reserve(8);
+    for (int i = 0; i < 4; ++i) {
+        vec.push_back(Base(i));
+    }
+    vec.insert(vec.begin() + 1, Base(9));
+    PolyVectorCounters counters = vec.stats().counters();
+    CHECK(counters.inserts == 1);
+    CHECK(counters.moved_bytes == 3 * sizeof(Base));
+
+    // Removes 1 and moves 2, 3 down
+    vec.erase_value(Base(1));
+    counters = vec.stats().counters();
+    CHECK(counters.erases == 1);
+    CHECK(counters.moved_bytes == 5 * sizeof(Base));
+    CHECK(counters.destroyed == 1);
+    CHECK(vec.size() == 4);
+
+    vec.erase_value(Base(7));
+    CHECK(vec.stats().counters().erases == 1);
+}
+
+TEST_CASE("Insert into a full vector splits relocation from the move") {
+    StatsVector vec;
+    vec.push_back(Base(0));
+    vec.push_back(Base(1));
+    vec.insert(vec.begin() + 1, Base(5));
+    PolyVectorCounters counters = vec.stats().counters();
+    CHECK(counters.reallocations == 2);
+    CHECK(counters.relocated_bytes == 2 * sizeof(Base));
+    CHECK(counters.moved_bytes == sizeof(Base));
+    CHECK(counters.peak_capacity == 4);
+    CHECK(vec[1].data == 5);
+    CHECK(vec[2].data == 1);
+}
+
+TEST_CASE("Destroyed elements are counted") {
+    StatsVector vec;
+    for (int i = 0; i < 6; ++i) {
+        vec.emplace_back<Base>(i);
+    }
+    vec.pop_back();
+    CHECK(vec.stats().counters().destroyed == 1);
+    vec.clear();
+    CHECK(vec.stats().counters().destroyed == 6);
+    CHECK(vec.stats().counters().peak_size == 6);
+}
+
+TEST_CASE("Registry aggregates live and destroyed instances") {
+    PolyVectorCounters before = PolyVectorStatsRegistry::instance().totals();
+    size_t live = PolyVectorStatsRegistry::instance().size();
+    {
+        StatsVector first;
+        first.stats().set_name("first");
+        StatsVector second;
+        for (int i = 0; i < 3; ++i) {
+            first.emplace_back<Base>(i);
+            second.emplace_back<Base>(i);
+        }
+        CHECK(PolyVectorStatsRegistry::instance().size() == live + 2);
+
+        auto instances = PolyVectorStatsRegistry::instance().instances();
+        bool named = false;
+        for (auto& [name, counters] : instances) {
+            if (name == "first") {
+                named = true;
+                CHECK(counters.peak_size == 3);
+            }
+        }
+        CHECK(named);
+        CHECK(PolyVectorStatsRegistry::instance().totals().allocations == before.allocations + 6);
+    }
+    CHECK(PolyVectorStatsRegistry::instance().size() == live);
+    PolyVectorCounters after = PolyVectorStatsRegistry::instance().totals();
+    CHECK(after.allocations == before.allocations + 6);
+    CHECK(after.destroyed == before.destroyed + 6);
+}
+
+TEST_CASE("Registry can be read while a vector grows") {
+    StatsVector vec;
+    std::thread writer([&] {
+        for (int i = 0; i < 10000; ++i) {
+            vec.emplace_back<Derived>(i);
+        }
+    });
+    for (int i = 0; i < 100; ++i) {
+        CHECK(PolyVectorStatsRegistry::instance().totals().peak_size <= 10000);
+    }
+    writer.join();
+    CHECK(vec.stats().counters().peak_size == 10000);
+}
+
+TEST_CASE("Growth is traced to its call site") {
+    PolyVectorGrowthTrace& trace = PolyVectorGrowthTrace::instance();
+    trace.clear();
+    StatsVector vec;
+    vec.stats().set_name("traced");
+    for (int i = 0; i < 4; ++i) {
+        vec.push_back(Base(i));
+    }
+    CHECK(trace.recorded() == 0);
+
+    trace.enable(true);
+    uint32_t push_line = __LINE__ + 2;
+    for (int i = 0; i < 12; ++i) {
+        vec.push_back(Base(i));
+    }
+    uint32_t emplace_line = __LINE__ + 1;
+    vec.emplace_back_at<Derived>(std::source_location::current(), 99);
+    uint32_t reserve_line = __LINE__ + 1;
+    vec.reserve(1000);
+    trace.enable(false);
+    vec.reserve(2000);
+
+    // Capacity 4 to 8 to 16 by push_back, 16 to 32 by emplace_back_at, then
+    // 32 to 1000 by reserve
+    std::vector<PolyVectorGrowthEvent> events = trace.events();
+    REQUIRE(events.size() == 4);
+    CHECK(std::strcmp(events[0].name, "traced") == 0);
+    CHECK(events[0].line == push_line);
+    CHECK(events[0].old_capacity == 4);
+    CHECK(events[0].new_capacity == 8);
+    CHECK(events[0].copied_bytes == 4 * sizeof(Base));
+    CHECK(events[2].line == emplace_line);
+    CHECK(events[3].line == reserve_line);
+    CHECK(events[3].copied_bytes == 17 * sizeof(Base));
+
+    // Sites by bytes copied: 17, 16, then 4 + 8 elements
+    std::vector<PolyVectorGrowthSite> top = trace.top(3);
+    REQUIRE(top.size() == 3);
+    CHECK(top[0].line == reserve_line);
+    CHECK(top[1].line == emplace_line);
+    CHECK(top[2].line == push_line);
+    CHECK(top[2].reallocations == 2);
+    CHECK(top[2].copied_bytes == 12 * sizeof(Base));
+    CHECK(top[2].largest_capacity == 16);
+    CHECK(std::strstr(top[0].file, "polyvector_stats_test.cpp") != nullptr);
+    CHECK(trace.top(1).size() == 1);
+
+    std::FILE* out = std::tmpfile();
+    trace.dump(out);
+    std::rewind(out);
+    char text[4096] = {};
+    std::fread(text, 1, sizeof(text) - 1, out);
+    std::fclose(out);
+    CHECK(std::strstr(text, "4 reallocations") != nullptr);
+    CHECK(std::strstr(text, "polyvector_stats_test.cpp") != nullptr);
+    trace.clear();
+}
+
+TEST_CASE("Plain emplace_back is traced inside polyvector.h") {
+    PolyVectorGrowthTrace& trace = PolyVectorGrowthTrace::instance();
+    trace.clear();
+    StatsVector vec;
+    vec.emplace_back<Base>(0);
+    trace.enable(true);
+    vec.emplace_back<Base>(1);
+    uint32_t macro_line = __LINE__ + 1;
+    POLYVECTOR_EMPLACE_BACK(vec, Derived, 2);
+    POLYVECTOR_EMPLACE_BACK(vec, Base, 3);
+    trace.enable(false);
+
+    std::vector<PolyVectorGrowthEvent> events = trace.events();
+    REQUIRE(events.size() == 2);
+    CHECK(std::strstr(events[0].file, "polyvector.h") != nullptr);
+    CHECK(std::strstr(events[1].file, "polyvector_stats_test.cpp") != nullptr);
+    CHECK(events[1].line == macro_line);
+    CHECK(vec[2].get_type() == DerivedT);
+    CHECK(vec.size() == 4);
+    trace.clear();
+}
+
+TEST_CASE("Growth trace keeps the latest events") {
+    PolyVectorGrowthTrace& trace = PolyVectorGrowthTrace::instance();
+    trace.clear();
+    StatsVector vec;
+    vec.push_back(Base(0));
+    // The first allocation copies nothing and isn't traced, so each reserve
+    // here is one event
+    trace.enable(true);
+    size_t extra = 10;
+    size_t last = 1 + PolyVectorGrowthTrace::ring_capacity + extra;
+    for (size_t capacity = 2; capacity <= last; ++capacity) {
+        vec.reserve(capacity);
+    }
+    trace.enable(false);
+
+    CHECK(trace.recorded() == PolyVectorGrowthTrace::ring_capacity + extra);
+    std::vector<PolyVectorGrowthEvent> events = trace.events();
+    REQUIRE(events.size() == PolyVectorGrowthTrace::ring_capacity);
+    CHECK(events.front().new_capacity == 2 + extra);
+    CHECK(events.back().new_capacity == last);
+    trace.clear();
+    CHECK(trace.events().empty());
+}
+
+TEST_CASE("Algorithms take instrumented vectors") {
+    StatsVector vec;
+    for (int i = 0; i < 10; ++i) {
+        if (i % 2 == 0) {
+            vec.emplace_back<Derived>(i);
+        }
+        else {
+            vec.emplace_back<Base>(i);
+        }
+    }
+    stable_sort_by_type(vec);
+    Type first = vec[0].get_type();
+    for (int i = 0; i < 5; ++i) {
+        CHECK(vec[i].get_type() == first);
+    }
+    CHECK(vec[5].get_type() != first);
+}
+TEST_SUITE_END();
@@ -0,0 +1,400 @@
+#ifndef POLYVECTOR_STREAM_H
+#define POLYVECTOR_STREAM_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "polyvector_io.h"
+
+// Streams of elements too large to hold in memory at once. The writer buffers
+// elements into fixed-size chunks and writes each full chunk as a type id
+// column followed by the raw slots. The reader holds two chunk-sized windows:
+// the caller works through one while a background thread reads the next chunk
+// into the other, so memory use does not depend on the file size. Element
+// types must be registered, as for save() and load().
+
+struct PolyStreamHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint64_t chunk_size;
+};
+
+constexpr char poly_stream_magic[8] = {'P', 'O', 'L', 'Y', 'S', 'T', 'R', '\0'};
+constexpr uint32_t poly_stream_version = 1;
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+class PolyStreamWriter {
+public:
+    // Member functions
+    PolyStreamWriter() = default;
+
+    PolyStreamWriter(PolyStreamWriter& other) = delete;
+    void operator=(PolyStreamWriter& other) = delete;
+
+    PolyStreamWriter(PolyStreamWriter&& other) = delete;
+    void operator=(PolyStreamWriter&& other) = delete;
+
+    ~PolyStreamWriter();
+
+    // File
+    bool open(const char* path, PolyTypeRegistry<Base>& registry, size_t chunk_size = 4096);
+    bool close();
+
+    // Modifiers
+    template <typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base>
+    bool emplace_back(Args&&... args);
+
+private:
+    std::FILE* file_ {nullptr};
+    PolyTypeRegistry<Base>* registry_ {nullptr};
+    PolyVector<Base> chunk_;
+    std::vector<uint32_t> ids_;
+    size_t chunk_size_ {0};
+    bool ok_ {false};
+
+    // Type id of the last element, to skip the registry lookup for runs of one type
+    const void* last_vptr_ {nullptr};
+    uint32_t last_id_ {0};
+
+    bool write_chunk();
+};
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+class PolyStreamReader {
+public:
+    // Member functions
+    PolyStreamReader() = default;
+
+    PolyStreamReader(PolyStreamReader& other) = delete;
+    void operator=(PolyStreamReader& other) = delete;
+
+    PolyStreamReader(PolyStreamReader&& other) = delete;
+    void operator=(PolyStreamReader&& other) = delete;
+
+    ~PolyStreamReader();
+
+    // File
+    bool open(const char* path, PolyTypeRegistry<Base>& registry);
+    void close();
+    bool failed();
+
+    // Chunks
+    bool next();
+    PolyVector<Base>& window();
+
+    template <typename F>
+    bool for_each(F&& f);
+
+private:
+    std::FILE* file_ {nullptr};
+    PolyTypeRegistry<Base>* registry_ {nullptr};
+    size_t chunk_size_ {0};
+    PolyVector<Base> windows_[2];
+    PolyVector<Base>* front_ {&windows_[0]};
+    PolyVector<Base>* back_ {&windows_[1]};
+    std::vector<uint32_t> ids_;
+
+    std::thread read_ahead_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    bool back_ready_ {false};
+    bool done_ {false};
+    bool failed_ {false};
+    bool stop_ {false};
+
+    void read_ahead();
+    bool read_chunk(PolyVector<Base>& window, bool& failed);
+};
+
+// PolyStreamWriter
+
+// private
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool PolyStreamWriter<Base>::write_chunk() {
+    uint64_t count = chunk_.size();
+    bool ok = std::fwrite(&count, sizeof(count), 1, file_) == 1
+        && std::fwrite(ids_.data(), sizeof(uint32_t), count, file_) == count
+        && std::fwrite(static_cast<void*>(chunk_.data()), sizeof(Base), count, file_) == count;
+    chunk_.clear();
+    ids_.clear();
+    return ok;
+}
+
+// Member functions
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+PolyStreamWriter<Base>::~PolyStreamWriter() {
+    close();
+}
+
+// File
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool PolyStreamWriter<Base>::open(const char* path, PolyTypeRegistry<Base>& registry, size_t chunk_size) {
+    close();
+    file_ = std::fopen(path, "wb");
+    if (file_ == nullptr || chunk_size == 0) {
+        close();
+        return false;
+    }
+    registry_ = &registry;
+    chunk_size_ = chunk_size;
+    chunk_.reserve(chunk_size);
+    ids_.reserve(chunk_size);
+    last_vptr_ = nullptr;
+
+    PolyStreamHeader header {};
+    std::memcpy(header.magic, poly_stream_magic, sizeof(header.magic));
+    header.version = poly_stream_version;
+    header.slot_size = sizeof(Base);
+    header.chunk_size = chunk_size;
+    ok_ = std::fwrite(&header, sizeof(header), 1, file_) == 1;
+    return ok_;
+}
+
+// Writes the last partial chunk. Returns false if any write since open failed.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool PolyStreamWriter<Base>::close() {
+    if (file_ == nullptr) {
+        chunk_.clear();
+        ids_.clear();
+        return false;
+    }
+    if (ok_ && chunk_.size() > 0) {
+        ok_ = write_chunk();
+    }
+    chunk_.clear();
+    ids_.clear();
+    bool ok = std::fclose(file_) == 0 && ok_;
+    file_ = nullptr;
+    ok_ = false;
+    return ok;
+}
+
+// Modifiers
+
+// Returns false without taking the element if Derived is not registered, and
+// for every element once a write has failed
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base>
+bool PolyStreamWriter<Base>::emplace_back(Args&&... args) {
+    if (!ok_) {
+        return false;
+    }
+    chunk_.template emplace_back<Derived>(std::forward<Args>(args)...);
+    const void* vptr = vptr_of(chunk_.back());
+    if (vptr != last_vptr_) {
+        std::optional<uint32_t> id = registry_->find_id(vptr);
+        if (!id) {
+            chunk_.pop_back();
+            return false;
+        }
+        last_vptr_ = vptr;
+        last_id_ = *id;
+    }
+    ids_.push_back(last_id_);
+    if (chunk_.size() == chunk_size_) {
+        ok_ = write_chunk();
+    }
+    return ok_;
+}
+
+// PolyStreamReader
+
+// private
+
+// Reads one chunk into window. Returns false at the end of the file or on
+// error, setting failed for the latter.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool PolyStreamReader<Base>::read_chunk(PolyVector<Base>& window, bool& failed) {
+    window.clear();
+    uint64_t count;
+    if (std::fread(&count, sizeof(count), 1, file_) != 1) {
+        failed = std::ferror(file_) != 0;
+        return false;
+    }
+
+    bool ok = count > 0 && count <= chunk_size_;
+    if (ok) {
+        ids_.resize(count);
+        ok = std::fread(ids_.data(), sizeof(uint32_t), count, file_) == count;
+    }
+    if (ok) {
+        Base* slots = window.append_uninitialized(count);
+        ok = std::fread(static_cast<void*>(slots), sizeof(Base), count, file_) == count
+            && restore_vptrs(slots, ids_.data(), count, *registry_);
+        if (!ok) {
+            window.release_elements();
+        }
+    }
+    failed = !ok;
+    return ok;
+}
+
+// Runs on the background thread, filling the back window whenever the caller
+// has taken the previous one
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+void PolyStreamReader<Base>::read_ahead() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        changed_.wait(lock, [this] { return stop_ || !back_ready_; });
+        if (stop_) {
+            return;
+        }
+
+        PolyVector<Base>* window = back_;
+        bool failed = false;
+        lock.unlock();
+        bool read = read_chunk(*window, failed);
+        lock.lock();
+
+        if (read) {
+            back_ready_ = true;
+        }
+        else {
+            done_ = true;
+            failed_ = failed;
+        }
+        changed_.notify_all();
+        if (done_) {
+            return;
+        }
+    }
+}
+
+// Member functions
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+PolyStreamReader<Base>::~PolyStreamReader() {
+    close();
+}
+
+// File
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool PolyStreamReader<Base>::open(const char* path, PolyTypeRegistry<Base>& registry) {
+    close();
+    file_ = std::fopen(path, "rb");
+    if (file_ == nullptr) {
+        failed_ = true;
+        return false;
+    }
+
+    PolyStreamHeader header;
+    bool ok = std::fseek(file_, 0, SEEK_END) == 0;
+    long file_size = ok ? std::ftell(file_) : -1;
+    ok = file_size >= static_cast<long>(sizeof(header))
+        && std::fseek(file_, 0, SEEK_SET) == 0
+        && std::fread(&header, sizeof(header), 1, file_) == 1
+        && std::memcmp(header.magic, poly_stream_magic, sizeof(header.magic)) == 0
+        && header.version == poly_stream_version
+        && header.slot_size == sizeof(Base)
+        && header.chunk_size > 0;
+    if (!ok) {
+        close();
+        failed_ = true;
+        return false;
+    }
+
+    // No valid chunk holds more elements than the file has room for, so a
+    // corrupt chunk size can't make the windows any larger than that
+    registry_ = &registry;
+    size_t in_file = (file_size - sizeof(header)) / (sizeof(uint32_t) + sizeof(Base));
+    chunk_size_ = std::min<uint64_t>(header.chunk_size, in_file);
+    windows_[0].reserve(chunk_size_);
+    windows_[1].reserve(chunk_size_);
+    ids_.reserve(chunk_size_);
+    read_ahead_ = std::thread(&PolyStreamReader::read_ahead, this);
+    return true;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+void PolyStreamReader<Base>::close() {
+    if (read_ahead_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        changed_.notify_all();
+        read_ahead_.join();
+    }
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+    file_ = nullptr;
+    windows_[0].clear();
+    windows_[1].clear();
+    back_ready_ = false;
+    done_ = false;
+    failed_ = false;
+    stop_ = false;
+}
+
+// True if open or a read failed, as opposed to reaching the end of the file
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool PolyStreamReader<Base>::failed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+// Chunks
+
+// Makes the next chunk the window, waiting for it if it is still being read.
+// Returns false at the end of the file or on error. The previous window's
+// elements are destroyed when their buffer is refilled.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool PolyStreamReader<Base>::next() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!read_ahead_.joinable()) {
+        return false;
+    }
+    changed_.wait(lock, [this] { return back_ready_ || done_; });
+    if (!back_ready_) {
+        front_->clear();
+        return false;
+    }
+    std::swap(front_, back_);
+    back_ready_ = false;
+    changed_.notify_all();
+    return true;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+PolyVector<Base>& PolyStreamReader<Base>::window() {
+    return *front_;
+}
+
+// Calls f on every remaining element in file order. Returns false on error.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+template<typename F>
+bool PolyStreamReader<Base>::for_each(F&& f) {
+    while (next()) {
+        for (Base& item : *front_) {
+            f(item);
+        }
+    }
+    return !failed();
+}
+
+#endif
@@ -0,0 +1,224 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "polyvector_stream.h"
+
+enum Type {BaseT, DerivedT, UnregisteredT};
+
+class Base {
+public:
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+class Unregistered : public Base {
+public:
+    Unregistered(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return UnregisteredT;
+    }
+};
+
+static std::string temp_path(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static void register_types(PolyTypeRegistry<Base>& registry) {
+    registry.add<Base>(1, 0);
+    registry.add<Derived>(2, 0);
+}
+
+static bool write_elements(const std::string& path, PolyTypeRegistry<Base>& registry, int count, size_t chunk_size) {
+    PolyStreamWriter<Base> writer;
+    bool ok = writer.open(path.c_str(), registry, chunk_size);
+    for (int i = 0; i < count; ++i) {
+        if (i % 2 == 0) {
+            ok &= writer.emplace_back<Base>(i);
+        }
+        else {
+            ok &= writer.emplace_back<Derived>(i);
+        }
+    }
+    return writer.close() && ok;
+}
+
+TEST_SUITE_BEGIN("Streams");
+TEST_CASE("Round trip through windows") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_stream_round_trip.bin");
+    CHECK(write_elements(path, registry, 1000, 64));
+
+    PolyStreamReader<Base> reader;
+    CHECK(reader.open(path.c_str(), registry));
+    int expected = 0;
+    int windows = 0;
+    bool intact = true;
+    bool bounded = true;
+    while (reader.next()) {
+        ++windows;
+        bounded &= reader.window().size() <= 64 && reader.window().capacity() <= 64;
+        for (Base& item : reader.window()) {
+            intact &= item.data == expected && item.get_type() == (expected % 2 == 0 ? BaseT : DerivedT);
+            ++expected;
+        }
+    }
+    CHECK(!reader.failed());
+    CHECK(expected == 1000);
+    CHECK(windows == 16);
+    CHECK(intact);
+    CHECK(bounded);
+    CHECK(!reader.next());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("for_each") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_stream_for_each.bin");
+    CHECK(write_elements(path, registry, 10000, 100));
+
+    PolyStreamReader<Base> reader;
+    CHECK(reader.open(path.c_str(), registry));
+    long long sum = 0;
+    int derived = 0;
+    CHECK(reader.for_each([&](Base& item) {
+        sum += item.data;
+        derived += item.get_type() == DerivedT;
+    }));
+    CHECK(sum == 10000LL * 9999 / 2);
+    CHECK(derived == 5000);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Empty stream") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_stream_empty.bin");
+    CHECK(write_elements(path, registry, 0, 8));
+
+    PolyStreamReader<Base> reader;
+    CHECK(reader.open(path.c_str(), registry));
+    CHECK(!reader.next());
+    CHECK(!reader.failed());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Closing before the end") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_stream_early_close.bin");
+    CHECK(write_elements(path, registry, 1000, 10));
+
+    PolyStreamReader<Base> reader;
+    CHECK(reader.open(path.c_str(), registry));
+    CHECK(reader.next());
+    CHECK(reader.window()[0].data == 0);
+    reader.close();
+    CHECK(!reader.next());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Unregistered type is rejected without losing the chunk") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_stream_unregistered.bin");
+
+    PolyStreamWriter<Base> writer;
+    CHECK(writer.open(path.c_str(), registry, 2));
+    CHECK(writer.emplace_back<Base>(1));
+    CHECK(!writer.emplace_back<Unregistered>(2));
+    CHECK(writer.emplace_back<Derived>(3));
+    CHECK(writer.emplace_back<Base>(4));
+    CHECK(writer.close());
+
+    PolyStreamReader<Base> reader;
+    CHECK(reader.open(path.c_str(), registry));
+    std::vector<int> data;
+    CHECK(reader.for_each([&](Base& item) { data.push_back(item.data); }));
+    CHECK(data == std::vector<int>{1, 3, 4});
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Read failures") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_stream_failure.bin");
+    CHECK(write_elements(path, registry, 100, 10));
+
+    PolyTypeRegistry<Base> partial;
+    partial.add<Base>(1, 0);
+    PolyStreamReader<Base> reader;
+    CHECK(reader.open(path.c_str(), partial));
+    CHECK(!reader.for_each([](Base&) {}));
+    CHECK(reader.failed());
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    CHECK(reader.open(path.c_str(), registry));
+    int count = 0;
+    CHECK(!reader.for_each([&](Base&) { ++count; }));
+    CHECK(count == 90);
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << "not a stream";
+    }
+    CHECK(!reader.open(path.c_str(), registry));
+    CHECK(reader.failed());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Corrupt chunk sizes fail without allocating") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string path = temp_path("polyvector_stream_corrupt.bin");
+
+    PolyStreamHeader header {};
+    std::memcpy(header.magic, poly_stream_magic, sizeof(header.magic));
+    header.version = poly_stream_version;
+    header.slot_size = sizeof(Base);
+    header.chunk_size = uint64_t{1} << 60;
+    uint64_t count = uint64_t{1} << 59;
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    // Header only: an empty stream, whatever chunk size it claims
+    PolyStreamReader<Base> reader;
+    CHECK(reader.open(path.c_str(), registry));
+    CHECK(reader.window().capacity() == 0);
+    CHECK(reader.for_each([](Base&) {}));
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    CHECK(reader.open(path.c_str(), registry));
+    CHECK(!reader.for_each([](Base&) {}));
+    CHECK(reader.failed());
+    reader.close();
+    std::filesystem::remove(path);
+}
+TEST_SUITE_END();
@@ -51,6 +51,7 @@ TEST_CASE("Concepts") {
     CHECK(!emplaceable_from<Base, Derived>);
 
     CHECK(std::forward_iterator<PolyVector<int>::iterator>);
+    CHECK(std::random_access_iterator<PolyVector<int>::iterator>);
 }
 
 TEST_CASE("Initializer list") {
@@ -93,6 +94,24 @@ TEST_CASE("Range for") {
         ++i;
     }
 }
+
+TEST_CASE("Iterator arithmetic") {
+    PolyVector<int> vec{1, 2, 3, 4};
+    auto it = vec.begin();
+
+    CHECK(*(it + 2) == 3);
+    CHECK(*(2 + it) == 3);
+    CHECK(it[3] == 4);
+    CHECK(vec.end() - it == 4);
+    CHECK(*(vec.end() - 1) == 4);
+    CHECK(*--vec.end() == 4);
+    CHECK(it < vec.end());
+    CHECK(vec.end() >= it);
+
+    it += 3;
+    it -= 1;
+    CHECK(*it == 3);
+}
 TEST_SUITE_END();
 
 TEST_SUITE_BEGIN("Capacity");
@@ -206,6 +225,19 @@ TEST_CASE("push_back") {
     CHECK(vec[2] == 3);
 }
 
+TEST_CASE("append_uninitialized") {
+    PolyVector<int> vec{1, 2};
+    int* slots = vec.append_uninitialized(3);
+    slots[0] = 3;
+    slots[1] = 4;
+    slots[2] = 5;
+
+    CHECK(vec.size() == 5);
+    CHECK(vec.capacity() >= 5);
+    CHECK(vec[0] == 1);
+    CHECK(vec[4] == 5);
+}
+
 TEST_CASE("pop_back") {
     PolyVector<int> vec{1, 2, 3};
     vec.pop_back();
@@ -276,6 +308,37 @@ TEST_CASE("Polymorphic clear") {
     CHECK(vec.size() == 0);
 }
 
+TEST_CASE("Polymorphic clear with spare capacity") {
+    Counter counter;
+    PolyVector<Base> vec;
+    vec.reserve(10);
+    vec.emplace_back<Base>(&counter, 1);
+    vec.emplace_back<Derived>(&counter, 2);
+
+    vec.clear();
+
+    CHECK(counter.destructor_count == 2);
+    CHECK(vec.size() == 0);
+    CHECK(vec.capacity() == 10);
+}
+
+TEST_CASE("Polymorphic release_elements") {
+    Counter counter;
+    PolyVector<Base> from;
+    from.emplace_back<Base>(&counter, 1);
+    from.emplace_back<Derived>(&counter, 2);
+
+    PolyVector<Base> to;
+    std::memcpy(static_cast<void*>(to.append_uninitialized(2)), static_cast<void*>(from.data()), sizeof(Base) * 2);
+    from.release_elements();
+
+    CHECK(from.size() == 0);
+    CHECK(to[0].get_type() == BaseT);
+    CHECK(to[1].get_type() == DerivedT);
+    CHECK(to[1].data == 2);
+    CHECK(counter.destructor_count == 0);
+}
+
 TEST_CASE("Polymorphic destructor") {
     Counter counter;
     PolyVector<Base> vec;
@@ -0,0 +1,238 @@
+#ifndef SHARDED_POLYVECTOR_H
+#define SHARDED_POLYVECTOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "polyvector.h"
+
+// A PolyVector per appending thread. local() returns the calling thread's own
+// shard, so appends need no synchronization. merge() relocates every shard into
+// one contiguous PolyVector with a single allocation, copying shards in
+// parallel when there is enough data. Iteration, size, merge and clear must not
+// run while threads are appending.
+template<typename Base, typename Allocator = std::allocator<Base>>
+class ShardedPolyVector {
+private:
+    // Padded so appends to neighbouring shards don't share a cache line
+    struct alignas(64) Shard {
+        PolyVector<Base, Allocator> vec;
+    };
+
+public:
+    // Member types
+    using value_type = Base;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+    using reference = Base&;
+    using pointer = Base*;
+    class iterator {
+        public:
+            // Member types
+            using difference_type = std::ptrdiff_t;
+            using value_type = Base;
+            using reference = Base&;
+            using pointer = Base*;
+            using iterator_category = std::forward_iterator_tag;
+
+            // Member functions
+            iterator() : mShards{nullptr}, mShard{0}, mIndex{0} {};
+            iterator(std::deque<Shard>* shards, size_t shard) : mShards{shards}, mShard{shard}, mIndex{0} {
+                skip_empty();
+            };
+
+            // operators
+            Base& operator*() const {
+                return (*mShards)[mShard].vec[mIndex];
+            }
+
+            iterator& operator++() {
+                ++mIndex;
+                skip_empty();
+                return *this;
+            }
+
+            iterator operator++(int) {
+                iterator tmp = *this;
+                ++(*this);
+                return tmp;
+            }
+
+            bool operator==(const iterator other) const {
+                return other.mShard == mShard && other.mIndex == mIndex;
+            }
+
+            bool operator!=(const iterator other) const {
+                return !(*this == other);
+            }
+
+        private:
+            std::deque<Shard>* mShards;
+            size_t mShard;
+            size_t mIndex;
+
+            void skip_empty() {
+                while (mShard < mShards->size() && mIndex == (*mShards)[mShard].vec.size()) {
+                    ++mShard;
+                    mIndex = 0;
+                }
+            }
+    };
+
+    // Member functions
+    ShardedPolyVector() = default;
+
+    ShardedPolyVector(ShardedPolyVector& other) = delete;
+    void operator=(ShardedPolyVector& other) = delete;
+
+    ShardedPolyVector(ShardedPolyVector&& other) = delete;
+    void operator=(ShardedPolyVector&& other) = delete;
+
+    // Shards
+    PolyVector<Base, Allocator>& local();
+    PolyVector<Base, Allocator>& shard(size_t index);
+    size_t shard_count();
+
+    // Iterators, shard by shard
+    iterator begin() {
+        return iterator(&shards_, 0);
+    }
+
+    iterator end() {
+        return iterator(&shards_, shards_.size());
+    }
+
+    template <typename F>
+    void for_each(F&& f);
+
+    // Capacity
+    size_t size();
+
+    // Modifiers
+    void clear();
+    void merge(PolyVector<Base, Allocator>& out);
+
+private:
+    static constexpr size_t parallel_merge_bytes = size_t{1} << 20;
+    static inline std::atomic<uint64_t> next_id_ {1};
+
+    uint64_t id_ {next_id_.fetch_add(1, std::memory_order_relaxed)};
+    std::deque<Shard> shards_;
+    std::unordered_map<std::thread::id, size_t> owners_;
+    std::mutex mutex_;
+};
+
+// Shards
+
+// The first call from a thread creates its shard; later calls hit a
+// thread-local cache. Instances are told apart by a process-unique id rather
+// than their address, which may be reused.
+template<typename Base, typename Allocator>
+PolyVector<Base, Allocator>& ShardedPolyVector<Base, Allocator>::local() {
+    struct Cache {
+        uint64_t owner {0};
+        PolyVector<Base, Allocator>* shard {nullptr};
+    };
+    static thread_local Cache cache;
+    if (cache.owner == id_) {
+        return *cache.shard;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [owner, inserted] = owners_.try_emplace(std::this_thread::get_id(), shards_.size());
+    if (inserted) {
+        shards_.emplace_back();
+    }
+    cache = {id_, &shards_[owner->second].vec};
+    return *cache.shard;
+}
+
+template<typename Base, typename Allocator>
+PolyVector<Base, Allocator>& ShardedPolyVector<Base, Allocator>::shard(size_t index) {
+    return shards_[index].vec;
+}
+
+template<typename Base, typename Allocator>
+size_t ShardedPolyVector<Base, Allocator>::shard_count() {
+    return shards_.size();
+}
+
+// Iterators
+
+template<typename Base, typename Allocator>
+template<typename F>
+void ShardedPolyVector<Base, Allocator>::for_each(F&& f) {
+    for (Shard& shard : shards_) {
+        for (Base& item : shard.vec) {
+            f(item);
+        }
+    }
+}
+
+// Capacity
+
+template<typename Base, typename Allocator>
+size_t ShardedPolyVector<Base, Allocator>::size() {
+    size_t total = 0;
+    for (Shard& shard : shards_) {
+        total += shard.vec.size();
+    }
+    return total;
+}
+
+// Modifiers
+
+template<typename Base, typename Allocator>
+void ShardedPolyVector<Base, Allocator>::clear() {
+    for (Shard& shard : shards_) {
+        shard.vec.clear();
+    }
+}
+
+// Appends every element to out, in shard order, and leaves the shards empty.
+// Elements are relocated bitwise, so no constructor or destructor runs.
+template<typename Base, typename Allocator>
+void ShardedPolyVector<Base, Allocator>::merge(PolyVector<Base, Allocator>& out) {
+    size_t total = size();
+    if (total == 0) {
+        return;
+    }
+
+    Base* destination = out.append_uninitialized(total);
+    auto relocate = [](Base* to, PolyVector<Base, Allocator>& from) {
+        std::memcpy(static_cast<void*>(to), static_cast<void*>(from.data()), sizeof(Base) * from.size());
+        from.release_elements();
+    };
+
+    if (total * sizeof(Base) < parallel_merge_bytes || shards_.size() == 1) {
+        for (Shard& shard : shards_) {
+            if (shard.vec.size() == 0) {
+                continue;
+            }
+            Base* to = destination;
+            destination += shard.vec.size();
+            relocate(to, shard.vec);
+        }
+        return;
+    }
+
+    std::vector<std::thread> copiers;
+    for (Shard& shard : shards_) {
+        if (shard.vec.size() == 0) {
+            continue;
+        }
+        Base* to = destination;
+        destination += shard.vec.size();
+        copiers.emplace_back(relocate, to, std::ref(shard.vec));
+    }
+    for (std::thread& copier : copiers) {
+        copier.join();
+    }
+}
+
+#endif
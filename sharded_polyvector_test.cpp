@@ -0,0 +1,143 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "sharded_polyvector.h"
+
+enum Type {BaseT, DerivedT};
+
+class Base {
+public:
+    static inline std::atomic<int> destructor_count {0};
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+
+    ~Base() {
+        ++destructor_count;
+    };
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+// Appends per_thread elements from each of thread_count threads
+static void fill(ShardedPolyVector<Base>& sharded, int thread_count, int per_thread) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&sharded, t, per_thread] {
+            PolyVector<Base>& shard = sharded.local();
+            for (int i = 0; i < per_thread; ++i) {
+                int data = t * per_thread + i;
+                if (data % 2 == 0) {
+                    shard.emplace_back<Base>(data);
+                }
+                else {
+                    sharded.local().emplace_back<Derived>(data);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+TEST_SUITE_BEGIN("ShardedPolyVector");
+TEST_CASE("local is per thread") {
+    ShardedPolyVector<int> sharded;
+    PolyVector<int>* main_shard = &sharded.local();
+    PolyVector<int>* other_shard = nullptr;
+    std::thread([&] { other_shard = &sharded.local(); }).join();
+
+    CHECK(&sharded.local() == main_shard);
+    CHECK(other_shard != main_shard);
+    CHECK(sharded.shard_count() == 2);
+}
+
+TEST_CASE("Iteration across shards") {
+    ShardedPolyVector<Base> sharded;
+    fill(sharded, 4, 100);
+
+    CHECK(sharded.shard_count() == 4);
+    CHECK(sharded.size() == 400);
+
+    std::vector<bool> seen(400, false);
+    bool types_match = true;
+    for (Base& item : sharded) {
+        seen[item.data] = true;
+        types_match &= item.get_type() == (item.data % 2 == 0 ? BaseT : DerivedT);
+    }
+    CHECK(types_match);
+    CHECK(std::find(seen.begin(), seen.end(), false) == seen.end());
+
+    int count = 0;
+    sharded.for_each([&](Base&) { ++count; });
+    CHECK(count == 400);
+}
+
+TEST_CASE("Iteration skips empty shards") {
+    ShardedPolyVector<int> sharded;
+    sharded.local();
+    std::thread([&] { sharded.local().push_back(7); }).join();
+    std::thread([&] { sharded.local(); }).join();
+
+    std::vector<int> items;
+    for (int item : sharded) {
+        items.push_back(item);
+    }
+    CHECK(items == std::vector<int>{7});
+}
+
+TEST_CASE_TEMPLATE("merge", Size, std::integral_constant<int, 100>, std::integral_constant<int, 20000>) {
+    Base::destructor_count = 0;
+    ShardedPolyVector<Base> sharded;
+    fill(sharded, 4, Size::value);
+
+    {
+        PolyVector<Base> merged;
+        merged.emplace_back<Base>(-1);
+        sharded.merge(merged);
+
+        CHECK(merged.size() == 4 * Size::value + 1);
+        CHECK(sharded.size() == 0);
+        CHECK(Base::destructor_count == 0);
+
+        std::vector<bool> seen(4 * Size::value, false);
+        bool types_match = true;
+        for (size_t index = 1; index < merged.size(); ++index) {
+            Base& item = merged[index];
+            seen[item.data] = true;
+            types_match &= item.get_type() == (item.data % 2 == 0 ? BaseT : DerivedT);
+        }
+        CHECK(types_match);
+        CHECK(std::find(seen.begin(), seen.end(), false) == seen.end());
+    }
+    CHECK(Base::destructor_count == 4 * Size::value + 1);
+}
+
+TEST_CASE("clear") {
+    Base::destructor_count = 0;
+    ShardedPolyVector<Base> sharded;
+    fill(sharded, 2, 10);
+    sharded.clear();
+
+    CHECK(sharded.size() == 0);
+    CHECK(Base::destructor_count == 20);
+}
+TEST_SUITE_END();
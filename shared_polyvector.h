@@ -0,0 +1,417 @@
+#ifndef SHARED_POLYVECTOR_H
+#define SHARED_POLYVECTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "polyvector_registry.h"
+
+// A fixed-capacity PolyVector in a named POSIX shared memory segment, for
+// handing elements from one process to another without serializing them. One
+// process creates the segment and appends; any number of others attach and
+// read. The segment holds no pointers: a header with offsets and the
+// published size, a type id per slot, and the slots. An appended element
+// becomes visible to readers when the size is published. The header also
+// records the writer's vptr for each type id it has written. Each reader maps
+// the segment read-only. While the writer's vptrs are the reader's own, as
+// for a fork or the same non-PIE binary, the reader calls the shared slots in
+// place and must not modify them. Once one differs, refresh() copies the
+// published slots into a private PolyVector and rewrites their vptrs there
+// for its own address space. The shared slots keep the writer's vptrs, so
+// the writer and every reader can call elements at once. Element types must
+// be registered and trivially serializable, as for save() and load().
+// Elements are never destroyed, in the segment or in a reader's copy.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+class SharedPolyVector {
+public:
+    // Member types
+    using value_type = Base;
+    using size_type = size_t;
+    using reference = Base&;
+    using pointer = Base*;
+    using iterator = typename PolyVector<Base>::iterator;
+
+    // Member functions
+    SharedPolyVector() = default;
+
+    SharedPolyVector(SharedPolyVector& other) = delete;
+    void operator=(SharedPolyVector& other) = delete;
+
+    SharedPolyVector(SharedPolyVector&& other) = delete;
+    void operator=(SharedPolyVector&& other) = delete;
+
+    ~SharedPolyVector();
+
+    // Segment
+    bool create(const char* name, size_t capacity, PolyTypeRegistry<Base>& registry);
+    bool attach(const char* name, PolyTypeRegistry<Base>& registry);
+    void close();
+    static bool remove(const char* name);
+
+    // Writer
+    template <typename Derived, typename... Args>
+    requires emplaceable_from<Derived, Base>
+    bool emplace_back(Args&&... args);
+
+    // Reader
+    size_t refresh();
+
+    // Element access, up to the last emplace_back or refresh. A reader's
+    // elements are the shared slots while zero_copy() holds, and its own
+    // copies after.
+    Base& operator[](size_t index);
+    bool zero_copy();
+
+    // Iterators
+    iterator begin() {
+        return iterator(elements());
+    }
+
+    iterator end() {
+        return iterator(elements() + size_);
+    }
+
+    // Capacity
+    size_t size();
+    size_t capacity();
+
+private:
+    static constexpr uint32_t max_types_ = 32;
+
+    struct Header {
+        char magic[8];
+        std::atomic<uint32_t> version;
+        uint32_t slot_size;
+        uint64_t capacity;
+        uint64_t type_offset;
+        uint64_t slot_offset;
+        // The writer's vptr for each type id it has written, published before
+        // the size. Types past max_types_ aren't recorded.
+        std::atomic<uint32_t> type_count;
+        struct {
+            uint32_t id;
+            uint64_t vptr;
+        } types[max_types_];
+        alignas(64) std::atomic<uint64_t> size;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free);
+    static_assert(alignof(Base) <= 64);
+
+    static constexpr char magic_[8] = {'P', 'O', 'L', 'Y', 'S', 'H', 'M', '\0'};
+    static constexpr uint32_t version_ = 2;
+
+    int fd_ {-1};
+    unsigned char* map_ {nullptr};
+    size_t map_bytes_ {0};
+    Header* header_ {nullptr};
+    uint32_t* ids_ {nullptr};
+    Base* data_ {nullptr};
+    size_t size_ {0};
+    PolyTypeRegistry<Base>* registry_ {nullptr};
+    const void* last_vptr_ {nullptr};
+    uint32_t last_id_ {0};
+    // A reader's fixed-up copies of the published slots, once it can't read
+    // them in place
+    PolyVector<Base> copies_;
+    bool reader_ {false};
+    bool zero_copy_ {false};
+    std::optional<uint32_t> matched_id_;
+
+    bool map(size_t bytes, int protection);
+    const void* vptr_for(uint32_t id);
+    void record_vptr(uint32_t id, const void* vptr);
+    bool writer_vptr_matches(uint32_t id);
+    Base* elements();
+};
+
+// private
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool SharedPolyVector<Base>::map(size_t bytes, int protection) {
+    void* map = mmap(nullptr, bytes, protection, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    map_ = static_cast<unsigned char*>(map);
+    map_bytes_ = bytes;
+    header_ = reinterpret_cast<Header*>(map_);
+    return true;
+}
+
+// This process's vptr for a type id, or nullptr if it is unregistered
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+const void* SharedPolyVector<Base>::vptr_for(uint32_t id) {
+    if (last_vptr_ == nullptr || id != last_id_) {
+        last_vptr_ = registry_->find_vptr(id);
+        last_id_ = id;
+    }
+    return last_vptr_;
+}
+
+// Records the writer's vptr for id, unless it is recorded or the table is full
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+void SharedPolyVector<Base>::record_vptr(uint32_t id, const void* vptr) {
+    uint32_t count = header_->type_count.load(std::memory_order_relaxed);
+    for (uint32_t index = 0; index < count; ++index) {
+        if (header_->types[index].id == id) {
+            return;
+        }
+    }
+    if (count < max_types_) {
+        header_->types[count].id = id;
+        header_->types[count].vptr = reinterpret_cast<uintptr_t>(vptr);
+        header_->type_count.store(count + 1, std::memory_order_release);
+    }
+}
+
+// Whether the writer's vptr for id is this process's, so its slots can be
+// called in place
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool SharedPolyVector<Base>::writer_vptr_matches(uint32_t id) {
+    if (id == matched_id_) {
+        return true;
+    }
+    uint32_t count = std::min(header_->type_count.load(std::memory_order_acquire), max_types_);
+    for (uint32_t index = 0; index < count; ++index) {
+        if (header_->types[index].id == id) {
+            if (header_->types[index].vptr != reinterpret_cast<uintptr_t>(vptr_for(id))) {
+                return false;
+            }
+            matched_id_ = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+Base* SharedPolyVector<Base>::elements() {
+    return reader_ && !zero_copy_ ? copies_.data() : data_;
+}
+
+// Member functions
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+SharedPolyVector<Base>::~SharedPolyVector() {
+    close();
+}
+
+// Segment
+
+// Creates the segment as the writer. Fails if a segment of that name exists.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool SharedPolyVector<Base>::create(const char* name, size_t capacity, PolyTypeRegistry<Base>& registry) {
+    close();
+    fd_ = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    size_t type_offset = sizeof(Header);
+    size_t slot_offset = (type_offset + sizeof(uint32_t) * capacity + 63) / 64 * 64;
+    size_t bytes = slot_offset + sizeof(Base) * capacity;
+    if (ftruncate(fd_, bytes) != 0 || !map(bytes, PROT_READ | PROT_WRITE)) {
+        close();
+        shm_unlink(name);
+        return false;
+    }
+
+    new (header_) Header {};
+    header_->slot_size = sizeof(Base);
+    header_->capacity = capacity;
+    header_->type_offset = type_offset;
+    header_->slot_offset = slot_offset;
+    std::memcpy(header_->magic, magic_, sizeof(magic_));
+    header_->version.store(version_, std::memory_order_release);
+
+    ids_ = reinterpret_cast<uint32_t*>(map_ + type_offset);
+    data_ = reinterpret_cast<Base*>(map_ + slot_offset);
+    registry_ = &registry;
+    return true;
+}
+
+// Attaches to a created segment as a reader. Fails if the segment doesn't
+// exist yet, was created for a different slot size, or its offsets don't lay
+// both columns out inside it.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool SharedPolyVector<Base>::attach(const char* name, PolyTypeRegistry<Base>& registry) {
+    close();
+    fd_ = shm_open(name, O_RDONLY, 0600);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    // Offsets are checked as poly_file_fits checks them
+    struct stat info;
+    bool ok = fstat(fd_, &info) == 0
+        && static_cast<size_t>(info.st_size) >= sizeof(Header)
+        && map(info.st_size, PROT_READ)
+        && header_->version.load(std::memory_order_acquire) == version_
+        && std::memcmp(header_->magic, magic_, sizeof(magic_)) == 0
+        && header_->slot_size == sizeof(Base)
+        && header_->type_offset >= sizeof(Header)
+        && header_->type_offset % alignof(uint32_t) == 0
+        && header_->type_offset <= header_->slot_offset
+        && header_->capacity <= (header_->slot_offset - header_->type_offset) / sizeof(uint32_t)
+        && header_->slot_offset % alignof(Base) == 0
+        && header_->slot_offset <= map_bytes_
+        && header_->capacity <= (map_bytes_ - header_->slot_offset) / sizeof(Base);
+    if (!ok) {
+        close();
+        return false;
+    }
+
+    ids_ = reinterpret_cast<uint32_t*>(map_ + header_->type_offset);
+    data_ = reinterpret_cast<Base*>(map_ + header_->slot_offset);
+    registry_ = &registry;
+    reader_ = true;
+    zero_copy_ = true;
+    return true;
+}
+
+// Unmaps the segment. It stays available to other processes until removed.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+void SharedPolyVector<Base>::close() {
+    if (map_ != nullptr) {
+        munmap(map_, map_bytes_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    map_ = nullptr;
+    map_bytes_ = 0;
+    header_ = nullptr;
+    ids_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+    last_vptr_ = nullptr;
+    // The copies belong to the writer's elements, so they aren't destroyed
+    copies_.release_elements();
+    reader_ = false;
+    zero_copy_ = false;
+    matched_id_.reset();
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool SharedPolyVector<Base>::remove(const char* name) {
+    return shm_unlink(name) == 0;
+}
+
+// Writer
+
+// Constructs the element in the next slot, records its type id and publishes
+// it. Returns false if this is a reader, the segment is full or Derived is not
+// registered.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+template<typename Derived, typename... Args>
+requires emplaceable_from<Derived, Base>
+bool SharedPolyVector<Base>::emplace_back(Args&&... args) {
+    if (map_ == nullptr || reader_ || size_ == header_->capacity) {
+        return false;
+    }
+
+    Derived* item = new (data_ + size_) Derived(std::forward<Args>(args)...);
+    const void* vptr = vptr_of<Base>(*item);
+    if (vptr != last_vptr_) {
+        std::optional<uint32_t> id = registry_->find_id(vptr);
+        if (!id) {
+            item->~Derived();
+            return false;
+        }
+        last_vptr_ = vptr;
+        last_id_ = *id;
+        record_vptr(last_id_, vptr);
+    }
+    ids_[size_] = last_id_;
+    ++size_;
+    header_->size.store(size_, std::memory_order_release);
+    return true;
+}
+
+// Reader
+
+// Takes in every element published since the last call and returns the new
+// size. Stops before the first slot with an unregistered type id. Slots whose
+// writer vptr is this process's are read in place; from the first that isn't,
+// every slot is copied and its copy's vptr rewritten. Copying may move
+// earlier copies, as growing a PolyVector does. The writer's size is its own.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+size_t SharedPolyVector<Base>::refresh() {
+    if (!reader_) {
+        return size_;
+    }
+
+    size_t published = std::min<uint64_t>(header_->size.load(std::memory_order_acquire), header_->capacity);
+    size_t ready = size_;
+    while (ready < published && vptr_for(ids_[ready]) != nullptr) {
+        ++ready;
+    }
+    for (size_t index = size_; zero_copy_ && index < ready; ++index) {
+        zero_copy_ = writer_vptr_matches(ids_[index]);
+    }
+    if (zero_copy_) {
+        size_ = ready;
+        return size_;
+    }
+
+    size_t copied = copies_.size();
+    if (ready > copied) {
+        Base* copies = copies_.append_uninitialized(ready - copied);
+        std::memcpy(static_cast<void*>(copies), static_cast<const void*>(data_ + copied), sizeof(Base) * (ready - copied));
+        for (size_t index = copied; index < ready; ++index) {
+            write_vptr(copies + (index - copied), vptr_for(ids_[index]));
+        }
+    }
+    size_ = ready;
+    return size_;
+}
+
+// Element access
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+Base& SharedPolyVector<Base>::operator[](size_t index) {
+    return elements()[index];
+}
+
+// Whether a reader calls the shared slots in place. The writer always does.
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+bool SharedPolyVector<Base>::zero_copy() {
+    return !reader_ || zero_copy_;
+}
+
+// Capacity
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+size_t SharedPolyVector<Base>::size() {
+    return size_;
+}
+
+template<typename Base>
+requires std::is_polymorphic_v<Base>
+size_t SharedPolyVector<Base>::capacity() {
+    return header_ == nullptr ? 0 : header_->capacity;
+}
+
+#endif
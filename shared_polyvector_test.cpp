@@ -0,0 +1,255 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include "shared_polyvector.h"
+
+enum Type {BaseT, DerivedT, UnregisteredT};
+
+class Base {
+public:
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    virtual Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    Derived(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return DerivedT;
+    }
+};
+
+class Unregistered : public Base {
+public:
+    Unregistered(int data_in) : Base(data_in) {};
+    virtual Type get_type() {
+        return UnregisteredT;
+    }
+};
+
+static std::string segment_name(const char* name) {
+    std::string segment = "/" + std::string(name) + "_" + std::to_string(getpid());
+    SharedPolyVector<Base>::remove(segment.c_str());
+    return segment;
+}
+
+static void register_types(PolyTypeRegistry<Base>& registry) {
+    registry.add<Base>(1, 0);
+    registry.add<Derived>(2, 0);
+}
+
+// Rewrites the writer's recorded vptr for the index-th type it wrote, which
+// follows the header's magic, version, slot size, capacity and offsets
+static void scribble_writer_vptr(const std::string& name, int index, uintptr_t vptr) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    REQUIRE(fd >= 0);
+    void* map = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    REQUIRE(map != MAP_FAILED);
+    std::memcpy(static_cast<unsigned char*>(map) + 56 + 16 * index, &vptr, sizeof(vptr));
+    munmap(map, 4096);
+    ::close(fd);
+}
+
+TEST_SUITE_BEGIN("SharedPolyVector");
+TEST_CASE("Reader sees published elements") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string name = segment_name("shared_polyvector_publish");
+
+    SharedPolyVector<Base> writer;
+    CHECK(writer.create(name.c_str(), 16, registry));
+    SharedPolyVector<Base> reader;
+    CHECK(reader.attach(name.c_str(), registry));
+    CHECK(reader.refresh() == 0);
+
+    CHECK(writer.emplace_back<Base>(1));
+    CHECK(writer.emplace_back<Derived>(2));
+    CHECK(writer.size() == 2);
+    CHECK(reader.size() == 0);
+
+    // Scribble over the vptrs, as if the writer's vtables lived elsewhere
+    write_vptr(&writer[0], reinterpret_cast<const void*>(0x1234));
+    write_vptr(&writer[1], reinterpret_cast<const void*>(0x5678));
+    scribble_writer_vptr(name, 0, 0x1234);
+    scribble_writer_vptr(name, 1, 0x5678);
+
+    CHECK(reader.refresh() == 2);
+    CHECK(!reader.zero_copy());
+    CHECK(reader[0].get_type() == BaseT);
+    CHECK(reader[1].get_type() == DerivedT);
+    CHECK(reader[1].data == 2);
+
+    int sum = 0;
+    for (Base& item : reader) {
+        sum += item.data;
+    }
+    CHECK(sum == 3);
+    SharedPolyVector<Base>::remove(name.c_str());
+}
+
+TEST_CASE("Full and unregistered") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string name = segment_name("shared_polyvector_full");
+
+    SharedPolyVector<Base> writer;
+    CHECK(writer.create(name.c_str(), 2, registry));
+    CHECK(!writer.emplace_back<Unregistered>(0));
+    CHECK(writer.emplace_back<Base>(1));
+    CHECK(writer.emplace_back<Base>(2));
+    CHECK(!writer.emplace_back<Base>(3));
+    CHECK(writer.size() == 2);
+    CHECK(writer.capacity() == 2);
+
+    SharedPolyVector<Base> other;
+    CHECK(!other.create(name.c_str(), 2, registry));
+    SharedPolyVector<Base>::remove(name.c_str());
+    CHECK(!other.attach(name.c_str(), registry));
+}
+
+TEST_CASE("Readers read matching slots in place") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string name = segment_name("shared_polyvector_in_place");
+
+    SharedPolyVector<Base> writer;
+    CHECK(writer.create(name.c_str(), 16, registry));
+    SharedPolyVector<Base> reader;
+    CHECK(reader.attach(name.c_str(), registry));
+    CHECK(!reader.emplace_back<Base>(0));
+
+    CHECK(writer.emplace_back<Derived>(1));
+    CHECK(writer.emplace_back<Base>(2));
+    CHECK(reader.refresh() == 2);
+    CHECK(reader.zero_copy());
+    CHECK(reader[0].get_type() == DerivedT);
+    CHECK(reader[1].get_type() == BaseT);
+
+    // The reader sees the writer's slots, not a copy of them
+    writer[0].data = 10;
+    CHECK(reader[0].data == 10);
+    SharedPolyVector<Base>::remove(name.c_str());
+}
+
+TEST_CASE("Readers copy once a writer vptr differs") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string name = segment_name("shared_polyvector_readers");
+
+    SharedPolyVector<Base> writer;
+    CHECK(writer.create(name.c_str(), 16, registry));
+    SharedPolyVector<Base> first;
+    SharedPolyVector<Base> second;
+    CHECK(first.attach(name.c_str(), registry));
+    CHECK(second.attach(name.c_str(), registry));
+
+    CHECK(writer.emplace_back<Base>(1));
+    CHECK(first.refresh() == 1);
+    CHECK(first.zero_copy());
+
+    // A type whose vtable lived elsewhere for the writer
+    CHECK(writer.emplace_back<Derived>(2));
+    write_vptr(&writer[1], reinterpret_cast<const void*>(0x5678));
+    scribble_writer_vptr(name, 1, 0x5678);
+    CHECK(first.refresh() == 2);
+    CHECK(second.refresh() == 2);
+    CHECK(!first.zero_copy());
+    CHECK(!second.zero_copy());
+    CHECK(first[0].get_type() == BaseT);
+    CHECK(first[1].get_type() == DerivedT);
+
+    // Each reader's copies are its own
+    CHECK(&first[0] != &second[0]);
+    first[0].data = 10;
+    CHECK(writer[0].data == 1);
+    CHECK(second[0].data == 1);
+
+    CHECK(writer.emplace_back<Base>(3));
+    CHECK(first.refresh() == 3);
+    CHECK(first[0].data == 10);
+    CHECK(first[2].get_type() == BaseT);
+    CHECK(first[2].data == 3);
+    CHECK(second.size() == 2);
+    SharedPolyVector<Base>::remove(name.c_str());
+}
+
+TEST_CASE("Attach rejects a header that doesn't fit the segment") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string name = segment_name("shared_polyvector_corrupt");
+
+    SharedPolyVector<Base> writer;
+    CHECK(writer.create(name.c_str(), 4, registry));
+
+    // Capacity sits after the magic, version and slot size
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    REQUIRE(fd >= 0);
+    void* map = mmap(nullptr, 64, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    REQUIRE(map != MAP_FAILED);
+    uint64_t* capacity = reinterpret_cast<uint64_t*>(static_cast<unsigned char*>(map) + 16);
+    REQUIRE(*capacity == 4);
+
+    *capacity = uint64_t{1} << 62;
+    SharedPolyVector<Base> reader;
+    CHECK(!reader.attach(name.c_str(), registry));
+    *capacity = 5000;
+    CHECK(!reader.attach(name.c_str(), registry));
+    *capacity = 4;
+    CHECK(reader.attach(name.c_str(), registry));
+
+    munmap(map, 64);
+    ::close(fd);
+    SharedPolyVector<Base>::remove(name.c_str());
+}
+
+TEST_CASE("Handoff between processes") {
+    PolyTypeRegistry<Base> registry;
+    register_types(registry);
+    std::string name = segment_name("shared_polyvector_fork");
+    constexpr int count = 10000;
+
+    SharedPolyVector<Base> writer;
+    CHECK(writer.create(name.c_str(), count, registry));
+
+    pid_t child = fork();
+    if (child == 0) {
+        SharedPolyVector<Base> reader;
+        bool ok = reader.attach(name.c_str(), registry);
+        while (ok && reader.refresh() < count) {
+            usleep(100);
+        }
+        // A fork shares the writer's vtables
+        ok = ok && reader.zero_copy();
+        for (int i = 0; ok && i < count; ++i) {
+            ok = reader[i].data == i && reader[i].get_type() == (i % 2 == 0 ? BaseT : DerivedT);
+        }
+        _exit(ok ? 0 : 1);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (i % 2 == 0) {
+            writer.emplace_back<Base>(i);
+        }
+        else {
+            writer.emplace_back<Derived>(i);
+        }
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+    SharedPolyVector<Base>::remove(name.c_str());
+}
+TEST_SUITE_END();
@@ -0,0 +1,267 @@
+#ifndef TYPED_POLYVECTOR_H
+#define TYPED_POLYVECTOR_H
+
+#include <cstdint>
+#include <new>
+#include <tuple>
+#include "polyvector.h"
+
+// A PolyVector over a closed set of types Ds, each the size of Base. The
+// dynamic type of each slot is a one-byte index into Ds kept in a sidecar
+// array, so Base needs no vtable and visit() calls f with the element's exact
+// type through a switch the compiler generates over Ds, without an indirect
+// call. Elements are destroyed as their exact type.
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+class TypedPolyVector {
+public:
+    static_assert(sizeof...(Ds) > 0 && sizeof...(Ds) <= 256, "type index must fit in a byte");
+
+    // Member types
+    using value_type = Base;
+    using size_type = size_t;
+    using reference = Base&;
+    using pointer = Base*;
+    using iterator = typename PolyVector<Base>::iterator;
+
+    // Index of Derived in Ds
+    template<typename Derived>
+    static constexpr uint8_t type_index_of = [] {
+        constexpr bool matches[] = {std::is_same_v<Derived, Ds>...};
+        for (size_t index = 0; index < sizeof...(Ds); ++index) {
+            if (matches[index]) {
+                return static_cast<uint8_t>(index);
+            }
+        }
+        return uint8_t{255};
+    }();
+
+    // Member functions
+    TypedPolyVector() = default;
+
+    TypedPolyVector(TypedPolyVector& other) = delete;
+    void operator=(TypedPolyVector& other) = delete;
+
+    TypedPolyVector(TypedPolyVector&& other) = delete;
+    void operator=(TypedPolyVector&& other) = delete;
+
+    ~TypedPolyVector();
+
+    // Element access
+    Base& operator[](size_t index);
+    Base& front();
+    Base& back();
+    Base* data();
+    uint8_t type_index(size_t index);
+    uint8_t* type_indices();
+
+    // Iterators
+    iterator begin() {
+        return iterator(data_);
+    }
+
+    iterator end() {
+        return iterator(data_ + size_);
+    }
+
+    // Visitation
+    template <typename F>
+    void visit(F&& f);
+    template <typename F>
+    decltype(auto) visit_at(size_t index, F&& f);
+
+    // Capacity
+    size_t size();
+    void reserve(size_t new_capacity);
+    size_t capacity();
+
+    // Modifiers
+    void clear();
+    template <typename Derived, typename... Args>
+    requires (std::is_same_v<Derived, Ds> || ...)
+    void emplace_back(Args&&... args);
+    void pop_back();
+
+private:
+    Base* data_ {nullptr};
+    uint8_t* types_ {nullptr};
+    size_t size_ {0};
+    size_t capacity_ {0};
+
+    void trusted_reserve(size_t new_capacity);
+
+    template<size_t I, typename F>
+    static decltype(auto) dispatch(uint8_t type, Base* slot, F& f);
+};
+
+// private
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+void TypedPolyVector<Base, Ds...>::trusted_reserve(size_t new_capacity) {
+    std::allocator<Base> allocator;
+    std::allocator<uint8_t> type_allocator;
+    Base* new_data = allocator.allocate(new_capacity);
+    uint8_t* new_types = type_allocator.allocate(new_capacity);
+
+    if (data_ != nullptr) {
+        std::memcpy(static_cast<void*>(new_data), static_cast<void*>(data_), sizeof(Base) * size_);
+        std::memcpy(new_types, types_, size_);
+        allocator.deallocate(data_, capacity_);
+        type_allocator.deallocate(types_, capacity_);
+    }
+    data_ = new_data;
+    types_ = new_types;
+    capacity_ = new_capacity;
+}
+
+// Calls f with the slot cast to Ds[type]. After inlining, the chain of
+// comparisons on type is lowered to a jump table or a short branch chain.
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+template<size_t I, typename F>
+decltype(auto) TypedPolyVector<Base, Ds...>::dispatch(uint8_t type, Base* slot, F& f) {
+    using Derived = std::tuple_element_t<I, std::tuple<Ds...>>;
+    if constexpr (I + 1 < sizeof...(Ds)) {
+        if (type != I) {
+            return dispatch<I + 1>(type, slot, f);
+        }
+    }
+    return f(*std::launder(reinterpret_cast<Derived*>(slot)));
+}
+
+// Member functions
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+TypedPolyVector<Base, Ds...>::~TypedPolyVector() {
+    clear();
+    if (data_ != nullptr) {
+        std::allocator<Base> allocator;
+        std::allocator<uint8_t> type_allocator;
+        allocator.deallocate(data_, capacity_);
+        type_allocator.deallocate(types_, capacity_);
+    }
+    data_ = nullptr;
+    types_ = nullptr;
+    capacity_ = 0;
+}
+
+// Element access
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+Base& TypedPolyVector<Base, Ds...>::operator[](size_t index) {
+    return data_[index];
+}
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+Base& TypedPolyVector<Base, Ds...>::front() {
+    return data_[0];
+}
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+Base& TypedPolyVector<Base, Ds...>::back() {
+    return data_[size_ - 1];
+}
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+Base* TypedPolyVector<Base, Ds...>::data() {
+    return data_;
+}
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+uint8_t TypedPolyVector<Base, Ds...>::type_index(size_t index) {
+    return types_[index];
+}
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+uint8_t* TypedPolyVector<Base, Ds...>::type_indices() {
+    return types_;
+}
+
+// Visitation
+
+// Calls f(D&) on every element, with D its exact type
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+template<typename F>
+void TypedPolyVector<Base, Ds...>::visit(F&& f) {
+    for (size_t index = 0; index < size_; ++index) {
+        dispatch<0>(types_[index], data_ + index, f);
+    }
+}
+
+// Returns f(D&) for one element. f must return the same type for every D.
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+template<typename F>
+decltype(auto) TypedPolyVector<Base, Ds...>::visit_at(size_t index, F&& f) {
+    return dispatch<0>(types_[index], data_ + index, f);
+}
+
+// Capacity
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+size_t TypedPolyVector<Base, Ds...>::size() {
+    return size_;
+}
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+void TypedPolyVector<Base, Ds...>::reserve(size_t new_capacity) {
+    if (new_capacity > capacity_) {
+        trusted_reserve(new_capacity);
+    }
+}
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+size_t TypedPolyVector<Base, Ds...>::capacity() {
+    return capacity_;
+}
+
+// Modifiers
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+void TypedPolyVector<Base, Ds...>::clear() {
+    visit([](auto& item) {
+        using Derived = std::remove_reference_t<decltype(item)>;
+        item.~Derived();
+    });
+    size_ = 0;
+}
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+template<typename Derived, typename... Args>
+requires (std::is_same_v<Derived, Ds> || ...)
+void TypedPolyVector<Base, Ds...>::emplace_back(Args&&... args) {
+    if (size_ == capacity_) {
+        trusted_reserve(capacity_ == 0 ? 1 : capacity_ * 2);
+    }
+    new (data_ + size_) Derived(std::forward<Args>(args)...);
+    types_[size_] = type_index_of<Derived>;
+    ++size_;
+}
+
+template<typename Base, typename... Ds>
+requires (emplaceable_from<Ds, Base> && ...)
+void TypedPolyVector<Base, Ds...>::pop_back() {
+    if (size_ > 0) {
+        visit_at(size_ - 1, [](auto& item) {
+            using Derived = std::remove_reference_t<decltype(item)>;
+            item.~Derived();
+        });
+        size_--;
+    }
+}
+
+#endif
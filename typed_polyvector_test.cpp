@@ -0,0 +1,133 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "typed_polyvector.h"
+
+enum Type {BaseT, DerivedT, OtherT};
+
+// No virtual functions, so no vptr in any slot
+class Base {
+public:
+    int data;
+
+    Base(int data_in) : data{data_in} {};
+
+    Base(Base&) = delete;
+    Base& operator=(Base&) = delete;
+    Base(Base&&) = delete;
+    Base& operator=(Base&&) = delete;
+
+    Type get_type() {
+        return BaseT;
+    }
+};
+
+class Derived : public Base {
+public:
+    static inline int destructor_count = 0;
+
+    Derived(int data_in) : Base(data_in) {};
+
+    ~Derived() {
+        ++destructor_count;
+    }
+
+    Type get_type() {
+        return DerivedT;
+    }
+};
+
+class Other : public Base {
+public:
+    static inline int destructor_count = 0;
+
+    Other(int data_in) : Base(data_in) {};
+
+    ~Other() {
+        ++destructor_count;
+    }
+
+    Type get_type() {
+        return OtherT;
+    }
+};
+
+using Vector = TypedPolyVector<Base, Base, Derived, Other>;
+
+TEST_SUITE_BEGIN("TypedPolyVector");
+TEST_CASE("Slots hold no vptr") {
+    CHECK(sizeof(Base) == sizeof(int));
+    CHECK(Vector::type_index_of<Base> == 0);
+    CHECK(Vector::type_index_of<Derived> == 1);
+    CHECK(Vector::type_index_of<Other> == 2);
+}
+
+TEST_CASE("emplace_back and visit") {
+    Vector vec;
+    for (int i = 0; i < 100; ++i) {
+        switch (i % 3) {
+            case 0: vec.emplace_back<Base>(i); break;
+            case 1: vec.emplace_back<Derived>(i); break;
+            default: vec.emplace_back<Other>(i); break;
+        }
+    }
+    CHECK(vec.size() == 100);
+    CHECK(vec.capacity() >= 100);
+    CHECK(vec.type_index(4) == 1);
+
+    int index = 0;
+    bool exact = true;
+    vec.visit([&](auto& item) {
+        exact &= item.data == index && item.get_type() == static_cast<Type>(index % 3);
+        ++index;
+    });
+    CHECK(index == 100);
+    CHECK(exact);
+
+    CHECK(vec.visit_at(5, [](auto& item) { return item.get_type(); }) == OtherT);
+    CHECK(vec.visit_at(6, [](auto& item) { return item.get_type(); }) == BaseT);
+}
+
+TEST_CASE("Iterators") {
+    Vector vec;
+    vec.emplace_back<Base>(1);
+    vec.emplace_back<Derived>(2);
+    vec.emplace_back<Other>(3);
+
+    int sum = 0;
+    for (Base& item : vec) {
+        sum += item.data;
+    }
+    CHECK(sum == 6);
+    CHECK(vec.end() - vec.begin() == 3);
+    CHECK(vec.front().data == 1);
+    CHECK(vec.back().data == 3);
+    CHECK(vec[1].get_type() == BaseT);
+}
+
+TEST_CASE("Elements are destroyed as their exact type") {
+    Derived::destructor_count = 0;
+    Other::destructor_count = 0;
+    {
+        Vector vec;
+        vec.emplace_back<Derived>(1);
+        vec.emplace_back<Other>(2);
+        vec.emplace_back<Other>(3);
+        vec.emplace_back<Base>(4);
+
+        vec.pop_back();
+        CHECK(Derived::destructor_count == 0);
+        CHECK(Other::destructor_count == 0);
+        vec.pop_back();
+        CHECK(Other::destructor_count == 1);
+        CHECK(vec.size() == 2);
+
+        vec.clear();
+        CHECK(Derived::destructor_count == 1);
+        CHECK(Other::destructor_count == 2);
+        CHECK(vec.size() == 0);
+
+        vec.emplace_back<Derived>(5);
+    }
+    CHECK(Derived::destructor_count == 2);
+}
+TEST_SUITE_END();